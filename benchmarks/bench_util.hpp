@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using benchclock = std::chrono::steady_clock;
+
+namespace coma {
+namespace bench {
+
+// parses arguments of the form --name=value
+class args
+{
+public:
+	args(int argc, char** argv)
+		: m_argc{argc}
+		, m_argv{argv}
+	{
+	}
+
+	long get(const char* name, long def) const
+	{
+		const auto len = std::strlen(name);
+		for (int i = 1; i < m_argc; ++i)
+		{
+			const char* a = m_argv[i];
+			if (std::strncmp(a, "--", 2) == 0 && std::strncmp(a + 2, name, len) == 0 &&
+				a[2 + len] == '=')
+				return std::strtol(a + 3 + len, nullptr, 10);
+		}
+		return def;
+	}
+
+private:
+	int m_argc;
+	char** m_argv;
+};
+
+inline unsigned hardware_threads()
+{
+	const auto n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// 1, 2, 4, ... up to and including max
+inline std::vector<unsigned> thread_counts(unsigned max)
+{
+	std::vector<unsigned> v;
+	for (unsigned n = 1; n < max; n *= 2)
+		v.push_back(n);
+	v.push_back(max);
+	return v;
+}
+
+inline std::uint64_t elapsed_ns(benchclock::time_point start,
+								benchclock::time_point end = benchclock::now())
+{
+	return static_cast<std::uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// collects latency samples in nanoseconds, not thread-safe
+class latencies
+{
+public:
+	void reserve(std::size_t n) { m_samples.reserve(n); }
+
+	void add(std::uint64_t ns) { m_samples.push_back(ns); }
+
+	void merge(const latencies& other)
+	{
+		m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+	}
+
+	std::size_t size() const noexcept { return m_samples.size(); }
+
+	// must be called before percentile()
+	void sort() { std::sort(m_samples.begin(), m_samples.end()); }
+
+	std::uint64_t percentile(double p) const
+	{
+		if (m_samples.empty())
+			return 0;
+		auto i = static_cast<std::size_t>(p * static_cast<double>(m_samples.size() - 1) + 0.5);
+		return m_samples[std::min(i, m_samples.size() - 1)];
+	}
+
+private:
+	std::vector<std::uint64_t> m_samples;
+};
+
+inline void print_header(const char* first_column)
+{
+	std::printf("%-28s %8s %14s %10s %10s %10s %10s\n", first_column, "threads", "ops/s",
+				"p50(us)", "p99(us)", "p999(us)", "max(us)");
+}
+
+inline void print_row(const std::string& name, unsigned threads, std::uint64_t ops,
+					  std::uint64_t total_ns, latencies& lat)
+{
+	lat.sort();
+	const double secs = static_cast<double>(total_ns) * 1e-9;
+	std::printf("%-28s %8u %14.0f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(), threads,
+				secs > 0 ? static_cast<double>(ops) / secs : 0.0, lat.percentile(0.5) * 1e-3,
+				lat.percentile(0.99) * 1e-3, lat.percentile(0.999) * 1e-3,
+				lat.percentile(1.0) * 1e-3);
+	std::fflush(stdout);
+}
+
+// run ctx on n threads (including the calling thread) until out of work
+template<class Context>
+void run_threads(Context& ctx, unsigned n)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(n - 1);
+	for (unsigned i = 1; i < n; ++i)
+		threads.emplace_back([&ctx] { ctx.run(); });
+	ctx.run();
+	for (auto& t : threads)
+		t.join();
+}
+
+} // namespace bench
+} // namespace coma
@@ -0,0 +1,211 @@
+// Echo servers over in-process socket pairs where each request is gated by a
+// semaphore, i.e. the connection limiting pattern from the README. Reports
+// throughput and round-trip latency of the simulated clients.
+//
+// usage: bench_concurrency_limiter [--clients=2000] [--permits=64]
+//                                  [--requests=50] [--size=64] [--threads=N]
+#include <utility>
+
+#include <coma/async_semaphore.hpp>
+#include <coma/experimental/async_semaphore_s.hpp>
+
+#include <bench_util.hpp>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+
+#if defined(COMA_COROUTINES) && defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+#include <sys/resource.h>
+
+namespace net = boost::asio;
+using net::awaitable;
+using net::use_awaitable;
+using socket_type = net::local::stream_protocol::socket;
+using context_executor = net::io_context::executor_type;
+
+namespace {
+
+struct config
+{
+	long clients;
+	long permits;
+	long requests;
+	long size;
+};
+
+// unsynchronized semaphore used on a single thread, only valid for one thread
+class direct_limiter
+{
+public:
+	direct_limiter(net::io_context& ctx, long permits)
+		: m_sem{ctx.get_executor(), permits}
+	{
+	}
+	awaitable<void> acquire() { return m_sem.async_acquire(use_awaitable); }
+	void release() { m_sem.release(); }
+
+private:
+	coma::async_semaphore<context_executor> m_sem;
+};
+
+// unsynchronized semaphore externally synchronized by a strand
+class strand_limiter
+{
+	using strand_type = net::strand<context_executor>;
+
+public:
+	strand_limiter(net::io_context& ctx, long permits)
+		: m_strand{ctx.get_executor()}
+		, m_sem{m_strand, permits}
+	{
+	}
+	awaitable<void> acquire()
+	{
+		return net::co_spawn(
+			m_strand,
+			[this]() -> awaitable<void> { co_await m_sem.async_acquire(use_awaitable); },
+			use_awaitable);
+	}
+	void release()
+	{
+		net::post(m_strand, [this] { m_sem.release(); });
+	}
+
+private:
+	strand_type m_strand;
+	coma::async_semaphore<strand_type> m_sem;
+};
+
+// thread-safe semaphore
+class synchronized_limiter
+{
+public:
+	synchronized_limiter(net::io_context& ctx, long permits)
+		: m_sem{ctx.get_executor(), permits}
+	{
+	}
+	awaitable<void> acquire() { return m_sem.async_acquire(); }
+	void release()
+	{
+		net::co_spawn(m_sem.get_executor(), m_sem.async_release(), net::detached);
+	}
+
+private:
+	coma::async_semaphore_s m_sem;
+};
+
+template<class Limiter>
+awaitable<void> echo_session(socket_type sock, Limiter& limiter, long size)
+{
+	std::vector<char> buf(static_cast<std::size_t>(size));
+	boost::system::error_code ec;
+	while (true)
+	{
+		co_await net::async_read(sock, net::buffer(buf), net::redirect_error(use_awaitable, ec));
+		if (ec)
+			co_return;
+		co_await limiter.acquire();
+		co_await net::async_write(sock, net::buffer(buf), net::redirect_error(use_awaitable, ec));
+		limiter.release();
+		if (ec)
+			co_return;
+	}
+}
+
+awaitable<void> client(socket_type sock, long requests, long size, coma::bench::latencies& lat)
+{
+	std::vector<char> buf(static_cast<std::size_t>(size), 'x');
+	lat.reserve(static_cast<std::size_t>(requests));
+	for (long i = 0; i < requests; ++i)
+	{
+		const auto start = benchclock::now();
+		co_await net::async_write(sock, net::buffer(buf), use_awaitable);
+		co_await net::async_read(sock, net::buffer(buf), use_awaitable);
+		lat.add(coma::bench::elapsed_ns(start));
+	}
+	// server session sees eof
+	sock.close();
+}
+
+template<class Limiter>
+void run(const char* name, const config& cfg, unsigned threads)
+{
+	net::io_context ctx{static_cast<int>(threads)};
+	Limiter limiter{ctx, cfg.permits};
+	std::vector<coma::bench::latencies> lats(static_cast<std::size_t>(cfg.clients));
+
+	for (auto& lat : lats)
+	{
+		socket_type a{ctx};
+		socket_type b{ctx};
+		net::local::connect_pair(a, b);
+		net::co_spawn(ctx, echo_session(std::move(b), limiter, cfg.size), net::detached);
+		net::co_spawn(ctx, client(std::move(a), cfg.requests, cfg.size, lat), net::detached);
+	}
+
+	const auto start = benchclock::now();
+	coma::bench::run_threads(ctx, threads);
+	const auto total = coma::bench::elapsed_ns(start);
+
+	coma::bench::latencies all;
+	all.reserve(static_cast<std::size_t>(cfg.clients * cfg.requests));
+	for (auto& lat : lats)
+		all.merge(lat);
+	coma::bench::print_row(name, threads, all.size(), total, all);
+}
+
+// each client uses two descriptors
+void raise_file_limit(long clients)
+{
+	rlimit lim{};
+	if (getrlimit(RLIMIT_NOFILE, &lim) != 0)
+		return;
+	const auto needed = static_cast<rlim_t>(2 * clients + 64);
+	if (lim.rlim_cur < needed)
+	{
+		lim.rlim_cur = std::min(needed, lim.rlim_max);
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const coma::bench::args args{argc, argv};
+	config cfg;
+	cfg.clients = args.get("clients", 2000);
+	cfg.permits = args.get("permits", 64);
+	cfg.requests = args.get("requests", 50);
+	cfg.size = args.get("size", 64);
+	const auto max_threads =
+		static_cast<unsigned>(args.get("threads", coma::bench::hardware_threads()));
+
+	raise_file_limit(cfg.clients);
+	std::printf("clients=%ld permits=%ld requests=%ld size=%ld\n", cfg.clients, cfg.permits,
+				cfg.requests, cfg.size);
+	coma::bench::print_header("limiter");
+	run<direct_limiter>("async_semaphore", cfg, 1);
+	for (auto n : coma::bench::thread_counts(max_threads))
+		run<strand_limiter>("async_semaphore + strand", cfg, n);
+	for (auto n : coma::bench::thread_counts(max_threads))
+		run<synchronized_limiter>("async_semaphore_s", cfg, n);
+}
+
+#else
+
+int main()
+{
+	std::puts("bench_concurrency_limiter requires coroutines and local sockets");
+}
+
+#endif
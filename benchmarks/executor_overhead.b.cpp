@@ -0,0 +1,148 @@
+// Cost of the type-erased default executor compared with concrete io_context
+// and strand executors. Single threaded acquire/release and wait/notify loops
+// on each primitive, reports ops/s and ns/op.
+//
+// usage: bench_executor_overhead [--ops=1000000] [--tasks=4]
+#include <utility>
+
+#include <coma/typed_executors.hpp>
+
+#include <bench_util.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <string>
+
+namespace net = boost::asio;
+
+namespace {
+
+template<class Executor>
+struct make_executor
+{
+	Executor operator()(net::io_context& ctx) const { return Executor{ctx.get_executor()}; }
+};
+
+template<class Executor>
+struct executor_name;
+template<>
+struct executor_name<coma::io::executor_type>
+{
+	static const char* get() { return "io_context"; }
+};
+template<>
+struct executor_name<coma::io_strand::executor_type>
+{
+	static const char* get() { return "strand<io_context>"; }
+};
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+template<>
+struct executor_name<net::any_io_executor>
+{
+	static const char* get() { return "any_io_executor"; }
+};
+#endif
+
+// acquire, then release in the completion handler and acquire again
+template<class Semaphore>
+struct acquire_loop
+{
+	Semaphore* sem;
+	long* remaining;
+
+	void operator()(boost::system::error_code)
+	{
+		sem->release();
+		if (--*remaining > 0)
+			sem->async_acquire(std::move(*this));
+	}
+};
+
+struct is_turn
+{
+	const long* turn;
+	long id;
+	bool operator()() const { return *turn == id; }
+};
+
+// two tasks taking turns through predicate waits
+template<class CondVar>
+struct ping_pong_loop
+{
+	CondVar* cv;
+	long* remaining;
+	long* turn;
+	long id;
+
+	void operator()(boost::system::error_code)
+	{
+		*turn = 1 - id;
+		cv->notify_all();
+		if (--*remaining > 0)
+			cv->async_wait(is_turn{turn, id}, std::move(*this));
+	}
+};
+
+template<class Executor, template<class> class Semaphore>
+void run_semaphore(const char* name, long ops, long tasks)
+{
+	net::io_context ctx{1};
+	Semaphore<Executor> sem{make_executor<Executor>{}(ctx), 1};
+	long remaining = ops;
+	for (long i = 0; i < tasks; ++i)
+		sem.async_acquire(acquire_loop<Semaphore<Executor>>{&sem, &remaining});
+	const auto start = benchclock::now();
+	ctx.run();
+	const auto ns = coma::bench::elapsed_ns(start);
+	std::printf("%-24s %-10s %-20s %14.0f %10.1f\n", name, "acquire", executor_name<Executor>::get(),
+				static_cast<double>(ops) * 1e9 / static_cast<double>(ns),
+				static_cast<double>(ns) / static_cast<double>(ops));
+}
+
+template<class Executor, template<class> class CondVar>
+void run_cond_var(const char* name, long ops)
+{
+	net::io_context ctx{1};
+	CondVar<Executor> cv{make_executor<Executor>{}(ctx)};
+	long remaining = ops;
+	long turn = 0;
+	for (long id = 0; id < 2; ++id)
+		cv.async_wait(is_turn{&turn, id},
+					  ping_pong_loop<CondVar<Executor>>{&cv, &remaining, &turn, id});
+	const auto start = benchclock::now();
+	ctx.run();
+	const auto ns = coma::bench::elapsed_ns(start);
+	std::printf("%-24s %-10s %-20s %14.0f %10.1f\n", name, "wait", executor_name<Executor>::get(),
+				static_cast<double>(ops) * 1e9 / static_cast<double>(ns),
+				static_cast<double>(ns) / static_cast<double>(ops));
+}
+
+template<class Executor>
+void run_all(long ops, long tasks)
+{
+	run_semaphore<Executor, coma::async_semaphore>("async_semaphore", ops, tasks);
+	run_semaphore<Executor, coma::async_semaphore_compact>("async_semaphore_compact", ops,
+														   tasks);
+	run_cond_var<Executor, coma::async_cond_var>("async_cond_var", ops);
+	run_cond_var<Executor, coma::async_cond_var_compact>("async_cond_var_compact", ops);
+	run_cond_var<Executor, coma::async_cond_var_timed>("async_cond_var_timed", ops);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const coma::bench::args args{argc, argv};
+	const long ops = args.get("ops", 1000000);
+	const long tasks = args.get("tasks", 4);
+
+	std::printf("ops=%ld tasks=%ld\n", ops, tasks);
+	std::printf("%-24s %-10s %-20s %14s %10s\n", "primitive", "op", "executor", "ops/s",
+				"ns/op");
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+	run_all<net::any_io_executor>(ops, tasks);
+#endif
+	run_all<coma::io::executor_type>(ops, tasks);
+	run_all<coma::io_strand::executor_type>(ops, tasks);
+}
@@ -0,0 +1,299 @@
+// Memory footprint of the primitives and of each parked waiter. Parks N
+// waiters on each primitive and reports sizeof the primitive without the
+// counters of stats() (wait_stats_mode::none) and with them (the default),
+// heap bytes and allocations per waiter (counted by replacing global
+// operator new) and resident bytes per waiter (from /proc/self/statm where
+// available). The sizeof budget applies to the primitives without counters.
+//
+// Exits with a non-zero status if a budget is exceeded.
+//
+// usage: bench_memory_footprint [--waiters=100000]
+//                               [--max-sizeof=N] [--max-bytes-per-waiter=N]
+#include <utility>
+
+#include <coma/async_cond_var.hpp>
+#include <coma/async_cond_var_compact.hpp>
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_semaphore.hpp>
+#include <coma/async_semaphore_compact.hpp>
+
+#include <bench_util.hpp>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <new>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace net = boost::asio;
+using context_executor = net::io_context::executor_type;
+
+namespace {
+
+std::atomic<long> g_live_bytes{0};
+std::atomic<long> g_allocs{0};
+
+// prefix each allocation with its size
+constexpr std::size_t header_size = alignof(std::max_align_t);
+
+void* counted_alloc(std::size_t n)
+{
+	auto* p = static_cast<char*>(std::malloc(n + header_size));
+	if (!p)
+		throw std::bad_alloc{};
+	*reinterpret_cast<std::size_t*>(p) = n;
+	g_live_bytes.fetch_add(static_cast<long>(n), std::memory_order_relaxed);
+	g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return p + header_size;
+}
+
+void counted_free(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	auto* p = static_cast<char*>(ptr) - header_size;
+	g_live_bytes.fetch_sub(static_cast<long>(*reinterpret_cast<std::size_t*>(p)),
+						   std::memory_order_relaxed);
+	std::free(p);
+}
+
+} // namespace
+
+void* operator new(std::size_t n)
+{
+	return counted_alloc(n);
+}
+void* operator new[](std::size_t n)
+{
+	return counted_alloc(n);
+}
+void operator delete(void* p) noexcept
+{
+	counted_free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	counted_free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+	counted_free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept
+{
+	counted_free(p);
+}
+
+namespace {
+
+long resident_bytes()
+{
+#if defined(__linux__)
+	long pages = 0;
+	long resident = 0;
+	if (auto* f = std::fopen("/proc/self/statm", "r"))
+	{
+		if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2)
+			resident = 0;
+		std::fclose(f);
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+struct budget
+{
+	long max_sizeof;
+	long max_bytes_per_waiter;
+	bool exceeded{false};
+};
+
+template<class CondVar>
+struct make_cond_var
+{
+	std::unique_ptr<CondVar> operator()(net::io_context& ctx) const
+	{
+		return std::unique_ptr<CondVar>(new CondVar{ctx.get_executor()});
+	}
+};
+
+template<class Semaphore>
+struct make_semaphore
+{
+	std::unique_ptr<Semaphore> operator()(net::io_context& ctx) const
+	{
+		return std::unique_ptr<Semaphore>(new Semaphore{ctx.get_executor(), 0});
+	}
+};
+
+// make(ctx) creates the primitive, park(prim, ctx) adds one waiter and drain(prim)
+// must complete all waiters. counted_size is sizeof the primitive with counters.
+template<class Make, class Park, class Drain>
+void measure(const char* primitive, const char* waiter, long n, budget& b, long counted_size,
+			 Make make, Park park, Drain drain)
+{
+	net::io_context ctx{1};
+	auto prim = make(ctx);
+	const auto size = static_cast<long>(sizeof(*prim));
+
+	const auto bytes0 = g_live_bytes.load();
+	const auto allocs0 = g_allocs.load();
+	const auto rss0 = resident_bytes();
+	for (long i = 0; i < n; ++i)
+		park(*prim, ctx);
+	ctx.poll();
+	ctx.restart();
+	const auto bytes = g_live_bytes.load() - bytes0;
+	const auto allocs = g_allocs.load() - allocs0;
+	const auto rss = resident_bytes() - rss0;
+
+	drain(*prim);
+	ctx.run();
+
+	const auto per_waiter = bytes / n;
+	const bool over = size > b.max_sizeof || per_waiter > b.max_bytes_per_waiter;
+	b.exceeded = b.exceeded || over;
+	std::printf("%-24s %-14s %8ld %8ld %12ld %12.2f %12ld %s\n", primitive, waiter, size,
+				counted_size, per_waiter, static_cast<double>(allocs) / static_cast<double>(n),
+				rss / n, over ? "OVER BUDGET" : "");
+}
+
+constexpr auto no_stats = coma::wait_stats_mode::none;
+
+void handler_waiters(long n, budget& b)
+{
+	using semaphore = coma::async_semaphore<context_executor, coma::null_wait_observer, no_stats>;
+	using cond_var = coma::async_cond_var<context_executor, coma::null_wait_observer, no_stats>;
+	using cond_var_timed =
+		coma::async_cond_var_timed<context_executor, coma::null_wait_observer, no_stats>;
+	using semaphore_compact = coma::async_semaphore_compact<context_executor, no_stats>;
+	using cond_var_compact =
+		coma::async_cond_var_compact<context_executor, coma::predicate_check::on_resume, no_stats>;
+	const long semaphore_size = sizeof(coma::async_semaphore<context_executor>);
+	const long cond_var_size = sizeof(coma::async_cond_var<context_executor>);
+	const long cond_var_timed_size = sizeof(coma::async_cond_var_timed<context_executor>);
+	const long semaphore_compact_size = sizeof(coma::async_semaphore_compact<context_executor>);
+	const long cond_var_compact_size = sizeof(coma::async_cond_var_compact<context_executor>);
+	long done = 0;
+	bool ready = false;
+	auto handler = [&done](boost::system::error_code) { ++done; };
+	auto pred = [&ready] { return ready; };
+
+	measure(
+		"async_semaphore", "acquire", n, b, semaphore_size,
+		make_semaphore<semaphore>{},
+		[&](semaphore& s, net::io_context&) { s.async_acquire(handler); },
+		[&](semaphore& s) { s.release(n); });
+	measure(
+		"async_cond_var", "wait", n, b, cond_var_size,
+		make_cond_var<cond_var>{},
+		[&](cond_var& cv, net::io_context&) { cv.async_wait(handler); },
+		[&](cond_var& cv) { cv.notify_all(); });
+	ready = false;
+	measure(
+		"async_cond_var", "wait(pred)", n, b, cond_var_size,
+		make_cond_var<cond_var>{},
+		[&](cond_var& cv, net::io_context&) { cv.async_wait(pred, handler); },
+		[&](cond_var& cv) {
+			ready = true;
+			cv.notify_all();
+		});
+	measure(
+		"async_cond_var_timed", "wait", n, b, cond_var_timed_size,
+		make_cond_var<cond_var_timed>{},
+		[&](cond_var_timed& cv, net::io_context&) { cv.async_wait(handler); },
+		[&](cond_var_timed& cv) { cv.notify_all(); });
+	measure(
+		"async_cond_var_timed", "wait_for", n, b, cond_var_timed_size,
+		make_cond_var<cond_var_timed>{},
+		[&](cond_var_timed& cv, net::io_context&) {
+			cv.async_wait_for(std::chrono::hours{1},
+							  [&done](boost::system::error_code, coma::cv_status) { ++done; });
+		},
+		[&](cond_var_timed& cv) { cv.notify_all(); });
+	measure(
+		"async_semaphore_compact", "acquire", n, b, semaphore_compact_size,
+		make_semaphore<semaphore_compact>{},
+		[&](semaphore_compact& s, net::io_context&) { s.async_acquire(handler); },
+		[&](semaphore_compact& s) { s.release(n); });
+	measure(
+		"async_cond_var_compact", "wait", n, b, cond_var_compact_size,
+		make_cond_var<cond_var_compact>{},
+		[&](cond_var_compact& cv, net::io_context&) { cv.async_wait(handler); },
+		[&](cond_var_compact& cv) { cv.notify_all(); });
+	ready = false;
+	measure(
+		"async_cond_var_compact", "wait(pred)", n, b, cond_var_compact_size,
+		make_cond_var<cond_var_compact>{},
+		[&](cond_var_compact& cv, net::io_context&) { cv.async_wait(pred, handler); },
+		[&](cond_var_compact& cv) {
+			ready = true;
+			cv.notify_all();
+		});
+}
+
+#if defined(COMA_COROUTINES)
+void coroutine_waiters(long n, budget& b)
+{
+	using semaphore = coma::async_semaphore<context_executor, coma::null_wait_observer, no_stats>;
+	using cond_var = coma::async_cond_var<context_executor, coma::null_wait_observer, no_stats>;
+	const long semaphore_size = sizeof(coma::async_semaphore<context_executor>);
+	const long cond_var_size = sizeof(coma::async_cond_var<context_executor>);
+	using net::awaitable;
+	using net::use_awaitable;
+
+	measure(
+		"async_semaphore", "co_await", n, b, semaphore_size,
+		make_semaphore<semaphore>{},
+		[](semaphore& s, net::io_context& ctx) {
+			net::co_spawn(
+				ctx,
+				[&s]() -> awaitable<void> { co_await s.async_acquire(use_awaitable); },
+				net::detached);
+		},
+		[&](semaphore& s) { s.release(n); });
+	measure(
+		"async_cond_var", "co_await", n, b, cond_var_size,
+		make_cond_var<cond_var>{},
+		[](cond_var& cv, net::io_context& ctx) {
+			net::co_spawn(
+				ctx,
+				[&cv]() -> awaitable<void> { co_await cv.async_wait(use_awaitable); },
+				net::detached);
+		},
+		[](cond_var& cv) { cv.notify_all(); });
+}
+#endif
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const coma::bench::args args{argc, argv};
+	const long n = args.get("waiters", 100000);
+	budget b{args.get("max-sizeof", 1L << 20), args.get("max-bytes-per-waiter", 1L << 20)};
+
+	std::printf("waiters=%ld max-sizeof=%ld max-bytes-per-waiter=%ld\n", n, b.max_sizeof,
+				b.max_bytes_per_waiter);
+	std::printf("%-24s %-14s %8s %8s %12s %12s %12s\n", "primitive", "waiter", "sizeof",
+				"+stats", "heap/waiter", "allocs/waiter", "rss/waiter");
+	handler_waiters(n, b);
+#if defined(COMA_COROUTINES)
+	coroutine_waiters(n, b);
+#endif
+	if (b.exceeded)
+	{
+		std::puts("memory budget exceeded");
+		return 1;
+	}
+}
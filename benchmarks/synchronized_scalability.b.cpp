@@ -0,0 +1,200 @@
+// Scalability of the synchronized (thread-safe) types when shared by tasks
+// running on 1, 2, 4, ... threads, either on one shared io_context or on one
+// io_context per thread. Reports ops/s and the latency of each operation.
+//
+// usage: bench_synchronized_scalability [--tasks=64] [--ops=2000]
+//                                       [--permits=8] [--threads=N]
+#include <utility>
+
+#include <coma/experimental/async_semaphore_s.hpp>
+#include <coma/experimental/stranded.hpp>
+
+#include <bench_util.hpp>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#if defined(COMA_COROUTINES)
+
+#include <atomic>
+#include <memory>
+
+namespace net = boost::asio;
+using net::awaitable;
+using net::use_awaitable;
+using context_executor = net::io_context::executor_type;
+using tracked_executor = decltype(net::require(std::declval<context_executor>(),
+											   net::execution::outstanding_work.tracked));
+
+namespace {
+
+struct config
+{
+	long tasks; // per thread
+	long ops;   // per task
+	long permits;
+};
+
+// acquire/release through the strand of async_semaphore_s
+class semaphore_workload
+{
+public:
+	semaphore_workload(const context_executor& ex, const config& cfg)
+		: m_sem{ex, cfg.permits}
+	{
+	}
+	awaitable<void> op()
+	{
+		co_await m_sem.async_acquire();
+		co_await m_sem.async_release();
+	}
+
+private:
+	coma::async_semaphore_s m_sem;
+};
+
+// mutate a value through stranded::invoke
+class stranded_workload
+{
+public:
+	stranded_workload(const context_executor& ex, const config&)
+		: m_value{ex}
+	{
+	}
+	awaitable<void> op()
+	{
+		return m_value.invoke([](long& v) { ++v; });
+	}
+
+private:
+	coma::stranded<long, context_executor> m_value;
+};
+
+// reference point: lock-free counter, yielding while no permits are available
+class atomic_workload
+{
+public:
+	atomic_workload(const context_executor&, const config& cfg)
+		: m_counter{cfg.permits}
+	{
+	}
+	awaitable<void> op()
+	{
+		auto c = m_counter.load(std::memory_order_relaxed);
+		while (c == 0 ||
+			   !m_counter.compare_exchange_weak(c, c - 1, std::memory_order_acquire,
+												std::memory_order_relaxed))
+		{
+			if (c == 0)
+			{
+				co_await net::post(co_await net::this_coro::executor, use_awaitable);
+				c = m_counter.load(std::memory_order_relaxed);
+			}
+		}
+		m_counter.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	std::atomic<long> m_counter;
+};
+
+template<class Workload>
+awaitable<void> task(Workload& w, long ops, coma::bench::latencies& lat,
+					 std::atomic<long>& remaining, std::vector<net::io_context*>& ctxs)
+{
+	lat.reserve(static_cast<std::size_t>(ops));
+	for (long i = 0; i < ops; ++i)
+	{
+		const auto start = benchclock::now();
+		co_await w.op();
+		lat.add(coma::bench::elapsed_ns(start));
+	}
+	if (remaining.fetch_sub(1) == 1)
+	{
+		for (auto* ctx : ctxs)
+			ctx->stop();
+	}
+}
+
+// contexts are kept alive by tracked executors until the last task completes since
+// tasks may be suspended on another context
+template<class Workload>
+void run(const char* name, const config& cfg, unsigned threads, bool shared)
+{
+	const auto nctx = shared ? 1u : threads;
+	std::vector<std::unique_ptr<net::io_context>> owned;
+	std::vector<net::io_context*> ctxs;
+	std::vector<tracked_executor> work;
+	for (unsigned i = 0; i < nctx; ++i)
+	{
+		owned.emplace_back(new net::io_context{shared ? static_cast<int>(threads) : 1});
+		ctxs.push_back(owned.back().get());
+		work.push_back(net::require(ctxs.back()->get_executor(),
+									net::execution::outstanding_work.tracked));
+	}
+
+	Workload w{ctxs.front()->get_executor(), cfg};
+	const auto ntasks = static_cast<std::size_t>(cfg.tasks) * threads;
+	std::vector<coma::bench::latencies> lats(ntasks);
+	std::atomic<long> remaining{static_cast<long>(ntasks)};
+	for (std::size_t i = 0; i < ntasks; ++i)
+		net::co_spawn(*ctxs[i % nctx], task(w, cfg.ops, lats[i], remaining, ctxs),
+					  net::detached);
+
+	const auto start = benchclock::now();
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; ++i)
+		pool.emplace_back([&, i] { ctxs[i % nctx]->run(); });
+	ctxs.front()->run();
+	for (auto& t : pool)
+		t.join();
+	const auto total = coma::bench::elapsed_ns(start);
+
+	coma::bench::latencies all;
+	all.reserve(ntasks * static_cast<std::size_t>(cfg.ops));
+	for (auto& lat : lats)
+		all.merge(lat);
+	coma::bench::print_row(std::string{name} + (shared ? " shared" : " per-thread"), threads,
+						   all.size(), total, all);
+}
+
+template<class Workload>
+void run_all(const char* name, const config& cfg, unsigned max_threads)
+{
+	for (auto n : coma::bench::thread_counts(max_threads))
+		run<Workload>(name, cfg, n, true);
+	for (auto n : coma::bench::thread_counts(max_threads))
+		run<Workload>(name, cfg, n, false);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const coma::bench::args args{argc, argv};
+	config cfg;
+	cfg.tasks = args.get("tasks", 64);
+	cfg.ops = args.get("ops", 2000);
+	cfg.permits = args.get("permits", 8);
+	const auto max_threads =
+		static_cast<unsigned>(args.get("threads", coma::bench::hardware_threads()));
+
+	std::printf("tasks/thread=%ld ops/task=%ld permits=%ld\n", cfg.tasks, cfg.ops,
+				cfg.permits);
+	coma::bench::print_header("workload");
+	run_all<semaphore_workload>("async_semaphore_s", cfg, max_threads);
+	run_all<stranded_workload>("stranded::invoke", cfg, max_threads);
+	run_all<atomic_workload>("std::atomic", cfg, max_threads);
+}
+
+#else
+
+int main()
+{
+	std::puts("bench_synchronized_scalability requires coroutines");
+}
+
+#endif
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <boost/asio/async_result.hpp>
+#include <boost/beast/core/async_base.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+namespace coma {
+
+namespace detail {
+
+// Acquires the permits of all semaphores or none, like std::lock: waits for
+// the semaphore that blocked, then tries to take the others without waiting.
+// If one of them blocks, the held permits are released and the wait moves
+// to that semaphore, such that no permits are held while suspended.
+template<class Handler, class Semaphore, std::size_t N>
+class acquire_all_op
+	: public netext::async_base<Handler, typename Semaphore::executor_type>
+{
+	using guard_type = acquire_all_guard<Semaphore, N>;
+	using permits_type = typename guard_type::permits_type;
+
+	permits_type m_permits;
+	// index of the semaphore waited for
+	std::size_t m_wait{0};
+
+	// takes the permits of all semaphores except skip, or returns the
+	// index of one which has not enough available
+	std::size_t try_take(std::size_t skip)
+	{
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			if (i != skip && m_permits[i].first->available() < m_permits[i].second)
+				return i;
+		}
+		for (std::size_t i = 0; i < N; ++i)
+		{
+			if (i != skip)
+			{
+				const bool taken = m_permits[i].first->try_acquire_n(m_permits[i].second);
+				assert(taken);
+				(void)taken;
+			}
+		}
+		return N;
+	}
+
+	void wait(std::size_t i)
+	{
+		m_wait = i;
+		auto& p = m_permits[i];
+		p.first->async_acquire_n(p.second, std::move(*this));
+	}
+
+public:
+	template<class H>
+	acquire_all_op(H&& h, const permits_type& permits)
+		: netext::async_base<Handler, typename Semaphore::executor_type>(
+			  std::forward<H>(h), permits[0].first->get_executor())
+		, m_permits(permits)
+	{
+		const auto blocked = try_take(N);
+		if (blocked == N)
+		{
+			this->complete(false, boost::system::error_code{},
+						   guard_type{m_permits, adapt_acquire});
+			return;
+		}
+		wait(blocked);
+	}
+
+	// permits of m_wait acquired
+	void operator()(boost::system::error_code ec)
+	{
+		if (ec)
+		{
+			this->complete_now(ec, guard_type{});
+			return;
+		}
+		const auto blocked = try_take(m_wait);
+		if (blocked == N)
+		{
+			this->complete_now(ec, guard_type{m_permits, adapt_acquire});
+			return;
+		}
+		auto& held = m_permits[m_wait];
+		held.first->release(held.second);
+		wait(blocked);
+	}
+};
+
+struct run_acquire_all_op
+{
+	template<class Handler, class Semaphore, std::size_t N>
+	void operator()(Handler&& h,
+					const std::array<std::pair<Semaphore*, std::ptrdiff_t>, N>& permits) const
+	{
+		acquire_all_op<typename std::decay<Handler>::type, Semaphore, N>(
+			std::forward<Handler>(h), permits);
+	}
+};
+
+// the arguments after the first semaphore and permit pair, the completion
+// token is the last one if their number is odd
+template<class Executor, bool HasToken, class... Rest>
+struct acquire_all_token
+{
+	using type = typename net::default_completion_token<Executor>::type;
+	static type get(Rest&&...) { return type{}; }
+};
+
+template<class Executor, class... Rest>
+struct acquire_all_token<Executor, true, Rest...>
+{
+	using type = typename std::tuple_element<sizeof...(Rest) - 1, std::tuple<Rest...>>::type;
+	static type&& get(Rest&&... rest)
+	{
+		return std::get<sizeof...(Rest) - 1>(std::forward_as_tuple(std::forward<Rest>(rest)...));
+	}
+};
+
+template<class Semaphore, std::size_t N, std::size_t I>
+void fill_permits(std::array<std::pair<Semaphore*, std::ptrdiff_t>, N>&,
+				  std::integral_constant<std::size_t, I>)
+{
+	static_assert(I == N, "");
+}
+
+template<class Semaphore, std::size_t N, std::size_t I, class Token>
+void fill_permits(std::array<std::pair<Semaphore*, std::ptrdiff_t>, N>&,
+				  std::integral_constant<std::size_t, I>, Token&&)
+{
+	static_assert(I == N, "");
+}
+
+template<class Semaphore, std::size_t N, std::size_t I, class... Rest>
+void fill_permits(std::array<std::pair<Semaphore*, std::ptrdiff_t>, N>& permits,
+				  std::integral_constant<std::size_t, I>, Semaphore& sem, std::ptrdiff_t n,
+				  Rest&&... rest)
+{
+	assert(n >= 0);
+	permits[I] = {&sem, n};
+	fill_permits(permits, std::integral_constant<std::size_t, I + 1>{},
+				 std::forward<Rest>(rest)...);
+}
+
+} // namespace detail
+
+// Acquires n1 permits of sem1, n2 of sem2 and so on atomically, such that
+// tasks never hold the permits of one semaphore while waiting for another.
+// The semaphores must be distinct and of the same type, e.g. async_semaphore.
+// Completes with a guard releasing all permits, the optional completion token
+// is the last argument:
+//   async_acquire_all(pool, 1, cpu, 4, [](error_code, acquire_all_guard<..., 2> g) {});
+// Waits are made on one semaphore at a time, such that an error of its
+// acquire completes the operation with an empty guard.
+template<class Semaphore, class... Rest,
+		 class TokenTraits = detail::acquire_all_token<typename Semaphore::executor_type,
+												 sizeof...(Rest) % 2 == 1, Rest...>,
+		 std::size_t N = (sizeof...(Rest) + 2) / 2>
+COMA_NODISCARD auto async_acquire_all(Semaphore& sem, std::ptrdiff_t n, Rest&&... rest) ->
+	typename net::async_result<typename std::decay<typename TokenTraits::type>::type,
+							   void(boost::system::error_code,
+									acquire_all_guard<Semaphore, N>)>::return_type
+{
+	using token_type = typename TokenTraits::type;
+	std::array<std::pair<Semaphore*, std::ptrdiff_t>, N> permits;
+	detail::fill_permits(permits, std::integral_constant<std::size_t, 0>{}, sem, n,
+						 std::forward<Rest>(rest)...);
+	auto&& token = TokenTraits::get(std::forward<Rest>(rest)...);
+	return net::async_initiate<token_type,
+							   void(boost::system::error_code, acquire_all_guard<Semaphore, N>)>(
+		detail::run_acquire_all_op{}, token, permits);
+}
+
+} // namespace coma
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <coma/async_semaphore.hpp>
+#include <coma/detail/core_async.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+namespace coma {
+
+// Limit algorithms of async_adaptive_limiter. update() is called for every
+// sample with the current limit, the round-trip time of the request, the
+// number of requests in flight (including the sampled one) and whether the
+// request was dropped (failed with a timeout or overload error), and returns
+// the new limit.
+
+// Additive increase, multiplicative decrease on drops or slow requests
+struct aimd_limit
+{
+	std::size_t initial = 20;
+	std::size_t min_limit = 1;
+	std::size_t max_limit = 1000;
+	// limit is multiplied by backoff on a drop
+	double backoff = 0.9;
+	// requests slower than timeout count as drops
+	std::chrono::nanoseconds timeout = std::chrono::seconds{5};
+
+	std::size_t update(std::size_t limit, std::chrono::nanoseconds rtt, std::size_t in_flight,
+					   bool dropped) noexcept
+	{
+		if (dropped || rtt > timeout)
+			return std::max(min_limit, static_cast<std::size_t>(limit * backoff));
+		// only grow if the limit is actually used
+		if (in_flight * 2 >= limit)
+			return std::min(max_limit, limit + 1);
+		return limit;
+	}
+};
+
+// TCP Vegas, estimates the queue from the ratio of the minimum round-trip
+// time to the sampled one and keeps it between alpha and beta, which scale
+// with log10(limit)
+struct vegas_limit
+{
+	std::size_t initial = 20;
+	std::size_t min_limit = 1;
+	std::size_t max_limit = 1000;
+	double alpha = 3;
+	double beta = 6;
+
+	std::size_t update(std::size_t limit, std::chrono::nanoseconds rtt, std::size_t in_flight,
+					   bool dropped) noexcept
+	{
+		if (rtt.count() <= 0)
+			return limit;
+		if (m_rtt_noload.count() == 0 || rtt < m_rtt_noload)
+			m_rtt_noload = rtt;
+		const auto step = std::max(1.0, std::log10(static_cast<double>(limit)));
+		double next = static_cast<double>(limit);
+		if (dropped)
+			next -= step;
+		else if (in_flight * 2 < limit)
+			return limit;
+		else
+		{
+			const auto queue = std::ceil(
+				limit * (1.0 - static_cast<double>(m_rtt_noload.count()) / rtt.count()));
+			if (queue <= alpha * step)
+				next += step;
+			else if (queue >= beta * step)
+				next -= step;
+		}
+		return clamp(next);
+	}
+
+private:
+	std::chrono::nanoseconds m_rtt_noload{0};
+
+	std::size_t clamp(double l) const noexcept
+	{
+		return std::min(max_limit,
+						std::max(min_limit, static_cast<std::size_t>(std::max(l, 0.0) + 0.5)));
+	}
+};
+
+// Gradient of a long-term average round-trip time to the sampled one,
+// the limit shrinks once latency grows and a queue of sqrt(limit) is allowed
+struct gradient_limit
+{
+	std::size_t initial = 20;
+	std::size_t min_limit = 1;
+	std::size_t max_limit = 1000;
+	// samples in the long-term average
+	double long_window = 600;
+	// ratio of the sampled round-trip time to the average which is tolerated
+	double tolerance = 1.5;
+	double smoothing = 0.2;
+
+	std::size_t update(std::size_t limit, std::chrono::nanoseconds rtt, std::size_t in_flight,
+					   bool dropped) noexcept
+	{
+		if (rtt.count() <= 0)
+			return limit;
+		const auto sample = static_cast<double>(rtt.count());
+		if (m_long_rtt == 0)
+			m_long_rtt = sample;
+		else
+			m_long_rtt += (sample - m_long_rtt) / long_window;
+		if (m_estimate == 0)
+			m_estimate = static_cast<double>(limit);
+		if (!dropped && in_flight * 2 < limit)
+			return limit;
+		const auto gradient =
+			dropped ? 0.5 : std::max(0.5, std::min(1.0, tolerance * m_long_rtt / sample));
+		const auto next = m_estimate * gradient + std::sqrt(m_estimate);
+		m_estimate = m_estimate * (1 - smoothing) + next * smoothing;
+		m_estimate = std::min(static_cast<double>(max_limit),
+							  std::max(static_cast<double>(min_limit), m_estimate));
+		return static_cast<std::size_t>(m_estimate);
+	}
+
+private:
+	double m_long_rtt{0};
+	double m_estimate{0};
+};
+
+// Semaphore whose number of permits follows a limit algorithm, not
+// thread-safe. Round-trip times are sampled from acquire to release, see
+// limit_guard. When the limit shrinks below the permits in flight, the
+// excess is held as debt and paid back by the following releases instead
+// of revoking permits, see async_semaphore::set_capacity().
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Algorithm = aimd_limit,
+		 class Clock = std::chrono::steady_clock>
+class async_adaptive_limiter
+{
+	using semaphore = async_semaphore<Executor>;
+	using default_token = typename net::default_completion_token<Executor>::type;
+
+public:
+	using executor_type = Executor;
+	using algorithm_type = Algorithm;
+	using clock = Clock;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_adaptive_limiter<E, Algorithm, Clock>;
+	};
+
+	explicit async_adaptive_limiter(const executor_type& ex,
+									const algorithm_type& algorithm = algorithm_type{})
+		: m_algorithm(algorithm)
+		, m_sem{ex, static_cast<std::ptrdiff_t>(m_algorithm.initial)}
+	{
+	}
+	~async_adaptive_limiter() = default;
+	async_adaptive_limiter(const async_adaptive_limiter&) = delete;
+	async_adaptive_limiter& operator=(const async_adaptive_limiter&) = delete;
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return m_sem.async_acquire(std::forward<CompletionToken>(token));
+	}
+
+	COMA_NODISCARD bool try_acquire() { return m_sem.try_acquire(); }
+
+	// returns the permit and updates the limit with the sample
+	void release(typename clock::duration rtt, bool dropped = false)
+	{
+		set_limit(m_algorithm.update(
+			limit(), std::chrono::duration_cast<std::chrono::nanoseconds>(rtt), in_flight(),
+			dropped));
+		release();
+	}
+
+	// returns the permit without a sample
+	void release() { m_sem.release(); }
+
+	// grows or shrinks the number of permits, release(rtt) sets the limit
+	// returned by the algorithm
+	void set_limit(std::size_t limit)
+	{
+		m_sem.set_capacity(static_cast<std::ptrdiff_t>(limit == 0 ? 1 : limit));
+	}
+
+	COMA_NODISCARD std::size_t limit() const noexcept
+	{
+		return static_cast<std::size_t>(m_sem.capacity());
+	}
+
+	// permits acquired and not yet released
+	COMA_NODISCARD std::size_t in_flight() const noexcept
+	{
+		return static_cast<std::size_t>(m_sem.capacity() + m_sem.debt() - m_sem.available());
+	}
+
+	const algorithm_type& algorithm() const noexcept { return m_algorithm; }
+
+	executor_type get_executor() { return m_sem.get_executor(); }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_sem.stats(); }
+
+private:
+	algorithm_type m_algorithm;
+	semaphore m_sem;
+};
+
+// Releases a permit of an adaptive limiter at scope exit with the time since
+// construction as sample, constructed after the permit was acquired
+template<class Limiter>
+class limit_guard
+{
+public:
+	using limiter_type = Limiter;
+	using clock = typename Limiter::clock;
+
+	COMA_NODISCARD limit_guard(Limiter& limiter, adapt_acquire_t) noexcept
+		: m_limiter{&limiter}
+		, m_start{clock::now()}
+	{
+	}
+
+	limit_guard(const limit_guard&) = delete;
+	COMA_NODISCARD limit_guard(limit_guard&& o) noexcept
+		: m_limiter{detail::exchange(o.m_limiter, nullptr)}
+		, m_start{o.m_start}
+		, m_dropped{o.m_dropped}
+	{
+	}
+	limit_guard& operator=(const limit_guard&) = delete;
+	limit_guard& operator=(limit_guard&&) = delete;
+
+	~limit_guard() { release(); }
+
+	// the request failed because of a timeout or overload, the limit backs off
+	void set_dropped() noexcept { m_dropped = true; }
+
+	void release()
+	{
+		if (m_limiter)
+			detail::exchange(m_limiter, nullptr)->release(clock::now() - m_start, m_dropped);
+	}
+
+	// releases without a sample, e.g. for requests failed by the client
+	void release_without_sample()
+	{
+		if (m_limiter)
+			detail::exchange(m_limiter, nullptr)->release();
+	}
+
+	COMA_NODISCARD bool owns_acquire() const noexcept { return m_limiter != nullptr; }
+
+private:
+	Limiter* m_limiter;
+	typename clock::time_point m_start;
+	bool m_dropped{false};
+};
+
+} // namespace coma
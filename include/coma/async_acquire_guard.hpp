@@ -0,0 +1,204 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace coma {
+
+namespace detail {
+
+template<class Executor, class = void>
+struct has_running_in_this_thread : std::false_type
+{
+};
+
+template<class Executor>
+struct has_running_in_this_thread<
+	Executor, void_t<decltype(std::declval<const Executor&>().running_in_this_thread())>>
+	: std::true_type
+{
+};
+
+template<class Executor>
+bool running_in_this_thread(const Executor& ex, std::true_type) noexcept
+{
+	return ex.running_in_this_thread();
+}
+
+// unknown executors are assumed to run elsewhere
+template<class Executor>
+bool running_in_this_thread(const Executor&, std::false_type) noexcept
+{
+	return false;
+}
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+// the polymorphic executor is checked for the common targets
+inline bool running_in_this_thread(const net::any_io_executor& ex, std::false_type) noexcept
+{
+	using io_executor = net::io_context::executor_type;
+	if (auto* io = ex.target<io_executor>())
+		return io->running_in_this_thread();
+	if (auto* strand = ex.target<net::strand<io_executor>>())
+		return strand->running_in_this_thread();
+	return false;
+}
+#endif
+
+template<class Executor>
+bool running_in_this_thread(const Executor& ex) noexcept
+{
+	return running_in_this_thread(ex, has_running_in_this_thread<Executor>{});
+}
+
+template<class Semaphore>
+void release_permits(Semaphore& sem, std::ptrdiff_t n)
+{
+	if (n == 1)
+		sem.release();
+	else
+		sem.release(n);
+}
+
+template<class Semaphore>
+struct deferred_release
+{
+	Semaphore* sem;
+	std::ptrdiff_t n;
+	void operator()() const { release_permits(*sem, n); }
+};
+
+} // namespace detail
+
+// Like unique_acquire_guard for the unsynchronized async semaphores, but
+// safe to release from any thread. The guard keeps the executor of the
+// semaphore and releases inline when called on it, otherwise all of its
+// permits are returned by a single post to the executor. Permits can be
+// moved into detached tasks running elsewhere without paying for the
+// synchronized variants on every operation. The semaphore must outlive
+// the posted release.
+template<class Semaphore>
+class async_unique_acquire_guard
+{
+public:
+	using semaphore_type = Semaphore;
+	using executor_type = typename Semaphore::executor_type;
+
+	async_unique_acquire_guard() = default;
+
+	// adopts n permits acquired before, e.g. by co_await sem.async_acquire_n(n)
+	COMA_NODISCARD async_unique_acquire_guard(Semaphore& sem, adapt_acquire_t,
+											  std::ptrdiff_t n = 1)
+		: m_sem{&sem}
+		, m_ex{sem.get_executor()}
+		, m_count{n}
+	{
+		assert(n >= 0);
+	}
+
+	COMA_NODISCARD async_unique_acquire_guard(Semaphore& sem, try_to_acquire_t)
+		: m_sem{&sem}
+		, m_ex{sem.get_executor()}
+		, m_count{sem.try_acquire() ? 1 : 0}
+	{
+	}
+
+	COMA_NODISCARD async_unique_acquire_guard(Semaphore& sem, defer_acquire_t)
+		: m_sem{&sem}
+		, m_ex{sem.get_executor()}
+	{
+	}
+
+	async_unique_acquire_guard(const async_unique_acquire_guard&) = delete;
+
+	COMA_NODISCARD async_unique_acquire_guard(async_unique_acquire_guard&& o) noexcept
+		: m_sem{detail::exchange(o.m_sem, nullptr)}
+		, m_ex{o.m_ex}
+		, m_count{detail::exchange(o.m_count, 0)}
+	{
+	}
+
+	~async_unique_acquire_guard()
+	{
+		if (owns_acquire())
+			do_release();
+	}
+
+	async_unique_acquire_guard& operator=(const async_unique_acquire_guard&) = delete;
+
+	async_unique_acquire_guard& operator=(async_unique_acquire_guard&& o) noexcept
+	{
+		if (owns_acquire())
+			do_release();
+		m_sem = detail::exchange(o.m_sem, nullptr);
+		m_ex = o.m_ex;
+		m_count = detail::exchange(o.m_count, 0);
+		return *this;
+	}
+
+	void release()
+	{
+		if (!owns_acquire())
+			throw std::system_error(
+				std::make_error_code(std::errc::operation_not_permitted),
+				"async_unique_acquire_guard::release(): does not own acquire");
+		do_release();
+	}
+
+	void swap(async_unique_acquire_guard& other) noexcept
+	{
+		std::swap(m_sem, other.m_sem);
+		std::swap(m_ex, other.m_ex);
+		std::swap(m_count, other.m_count);
+	}
+
+	// equivalent to std::unique_lock::release()
+	COMA_NODISCARD semaphore_type* release_ownership() noexcept
+	{
+		m_count = 0;
+		return detail::exchange(m_sem, nullptr);
+	}
+
+	COMA_NODISCARD semaphore_type* semaphore() const noexcept { return m_sem; }
+
+	// number of permits owned
+	COMA_NODISCARD std::ptrdiff_t count() const noexcept { return m_sem ? m_count : 0; }
+
+	COMA_NODISCARD bool owns_acquire() const noexcept { return m_sem && m_count > 0; }
+
+	explicit operator bool() const noexcept { return owns_acquire(); }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+private:
+	Semaphore* m_sem{nullptr};
+	executor_type m_ex;
+	std::ptrdiff_t m_count{0};
+
+	void do_release()
+	{
+		const auto n = detail::exchange(m_count, 0);
+		if (detail::running_in_this_thread(m_ex))
+			detail::release_permits(*m_sem, n);
+		else
+			net::post(m_ex, detail::deferred_release<Semaphore>{m_sem, n});
+	}
+};
+
+template<class Sem>
+void swap(async_unique_acquire_guard<Sem>& a, async_unique_acquire_guard<Sem>& b) noexcept
+{
+	a.swap(b);
+}
+
+} // namespace coma
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/error.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <boost/asio/basic_waitable_timer.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+
+namespace coma {
+
+// Overload control of async_codel_semaphore, the durations are queueing
+// delays (sojourn times) of waiters
+template<class Clock = std::chrono::steady_clock>
+struct codel_params
+{
+	using duration = typename Clock::duration;
+
+	// overloaded if no waiter was served within target in the last interval
+	duration target = std::chrono::milliseconds{5};
+	duration interval = std::chrono::milliseconds{100};
+	// while overloaded, waiters parked for longer are dropped
+	duration budget = std::chrono::milliseconds{10};
+};
+
+namespace detail {
+
+template<class Clock>
+struct codel_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+	typename Clock::time_point parked{};
+};
+
+} // namespace detail
+
+// Variant of async_semaphore_compact for load shedding, not thread-safe.
+// Waiters are served in FIFO order until the minimum queueing delay of an
+// interval exceeds the target (CoDel). While overloaded, waiters are served
+// in LIFO order, such that fresh requests are served while they are still
+// useful, and waiters parked for longer than the budget complete with
+// coma::error::dropped (counted as timeouts in stats()). While tasks are
+// parked a timer ends the interval, and while overloaded it drops the oldest
+// waiter once it exceeds the budget, even if no permits are released.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Clock = std::chrono::steady_clock>
+class async_codel_semaphore
+{
+	using timer = net::basic_waitable_timer<Clock, net::wait_traits<Clock>, Executor>;
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::codel_waiter<Clock>;
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+
+	struct initiate_acquire
+	{
+		async_codel_semaphore* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n) const
+		{
+			self->start_acquire(std::forward<Handler>(h), n);
+		}
+	};
+
+	// does not keep the semaphore alive, aborted when it is destroyed
+	struct on_timer
+	{
+		async_codel_semaphore* self;
+		void operator()(boost::system::error_code ec) const
+		{
+			if (ec == net::error::operation_aborted)
+				return;
+			self->m_armed = time_point::max();
+			self->wake_waiters();
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	using clock = Clock;
+	using params_type = codel_params<Clock>;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_codel_semaphore<E, Clock>;
+	};
+
+	async_codel_semaphore(const executor_type& ex, std::ptrdiff_t init,
+						  const params_type& params = params_type{})
+		: m_ex{ex}
+		, m_timer{ex}
+		, m_counter{init}
+		, m_params(params)
+		, m_interval_end{Clock::now() + params.interval}
+	{
+		assert(0 <= m_counter);
+	}
+	async_codel_semaphore(executor_type&& ex, std::ptrdiff_t init,
+						  const params_type& params = params_type{})
+		: m_ex{std::move(ex)}
+		, m_timer{m_ex}
+		, m_counter{init}
+		, m_params(params)
+		, m_interval_end{Clock::now() + params.interval}
+	{
+		assert(0 <= m_counter);
+	}
+	// parked waiters complete with operation_aborted
+	~async_codel_semaphore() { m_waiters.abort_all(); }
+	async_codel_semaphore(const async_codel_semaphore&) = delete;
+	async_codel_semaphore& operator=(const async_codel_semaphore&) = delete;
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1});
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_n(std::ptrdiff_t n,
+										CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, n);
+	}
+
+	// fails if there are waiting tasks
+	COMA_NODISCARD bool try_acquire()
+	{
+		assert(m_counter >= 0);
+		if (m_counter == 0 || !m_waiters.empty())
+		{
+			return false;
+		}
+		--m_counter;
+		m_counters.acquire();
+		return true;
+	}
+
+	void release()
+	{
+		++m_counter;
+		wake_waiters();
+	}
+
+	void release(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		m_counter += n;
+		wake_waiters();
+	}
+
+	// waiters are served LIFO and dropped after the budget
+	COMA_NODISCARD bool overloaded() const noexcept { return m_overloaded; }
+
+	const params_type& params() const noexcept { return m_params; }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	executor_type m_ex;
+	timer m_timer;
+	std::ptrdiff_t m_counter;
+	params_type m_params;
+	time_point m_interval_end;
+	// minimum queueing delay of the served waiters in the current interval
+	duration m_min_delay{duration::max()};
+	bool m_overloaded{false};
+	// expiry of the pending timer wait, max if none
+	time_point m_armed{time_point::max()};
+	detail::wait_counters m_counters;
+	detail::waiter_list<waiter> m_waiters;
+
+	template<class Handler>
+	void start_acquire(Handler&& h, std::ptrdiff_t n)
+	{
+		if (m_waiters.empty() && m_counter >= n)
+		{
+			m_counter -= n;
+			m_counters.acquire();
+			detail::post_completion(std::forward<Handler>(h), m_ex,
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		state.parked = Clock::now();
+		update(state.parked);
+		m_counters.park();
+		m_waiters.push_back(detail::make_handler_node(std::forward<Handler>(h), m_ex, state));
+		arm();
+	}
+
+	// ends the interval once it elapsed and drops expired waiters
+	void update(time_point now)
+	{
+		if (now >= m_interval_end)
+		{
+			// nothing served this interval, the oldest waiter tells the delay
+			if (m_min_delay == duration::max())
+				m_min_delay =
+					m_waiters.empty() ? duration::zero() : now - m_waiters.front()->parked;
+			m_overloaded = m_min_delay > m_params.target;
+			m_min_delay = duration::max();
+			m_interval_end = now + m_params.interval;
+		}
+		if (!m_overloaded)
+			return;
+		// parked in order, the oldest waiters are at the front
+		while (!m_waiters.empty() && now - m_waiters.front()->parked > m_params.budget)
+		{
+			auto* w = m_waiters.pop_front();
+			m_counters.unpark();
+			m_counters.timeout();
+			w->wake(error::dropped);
+		}
+	}
+
+	void wake_waiters()
+	{
+		if (m_waiters.empty())
+			return;
+		const auto now = Clock::now();
+		update(now);
+		while (!m_waiters.empty())
+		{
+			auto* w = m_overloaded ? m_waiters.back() : m_waiters.front();
+			if (w->n > m_counter)
+				break;
+			m_waiters.erase(w);
+			m_counter -= w->n;
+			if (now - w->parked < m_min_delay)
+				m_min_delay = now - w->parked;
+			m_counters.unpark();
+			m_counters.wakeup();
+			m_counters.acquire();
+			w->wake();
+		}
+		arm();
+	}
+
+	// while tasks are parked, waits for the end of the interval or, while
+	// overloaded, until the oldest waiter exceeds the budget
+	void arm()
+	{
+		auto next = time_point::max();
+		if (!m_waiters.empty())
+			next = m_overloaded ? m_waiters.front()->parked + m_params.budget + duration{1}
+								: m_interval_end;
+		if (next == m_armed)
+			return;
+		m_armed = next;
+		if (next == time_point::max())
+		{
+			m_timer.cancel();
+			return;
+		}
+		m_timer.expires_at(next);
+		m_timer.async_wait(on_timer{this});
+	}
+};
+
+} // namespace coma
@@ -7,9 +7,13 @@
 
 namespace coma {
 
-template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
-class async_cond_var
+// Observer receives the events of each wait, see null_wait_observer
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Observer = null_wait_observer,
+		 wait_stats_mode Stats = wait_stats_mode::counted>
+class async_cond_var : public detail::wait_monitor<detail::observer_policy<Observer, Stats>>
 {
+	using monitor_type = detail::wait_monitor<detail::observer_policy<Observer, Stats>>;
+
 	using clock = std::chrono::steady_clock;
 	using timer = net::basic_waitable_timer<clock, net::wait_traits<clock>, Executor>;
 	using default_token = typename net::default_completion_token<Executor>::type;
@@ -19,15 +23,17 @@ public:
 	template<class E>
 	struct rebind_executor
 	{
-		using other = async_cond_var<E>;
+		using other = async_cond_var<E, Observer, Stats>;
 	};
 
 	explicit async_cond_var(const executor_type& ex)
-		: m_timer{ex, timer::time_point::max()}
+		: monitor_type{"async_cond_var"}
+		, m_timer{ex, timer::time_point::max()}
 	{
 	}
 	explicit async_cond_var(executor_type&& ex)
-		: m_timer{std::move(ex), timer::time_point::max()}
+		: monitor_type{"async_cond_var"}
+		, m_timer{std::move(ex), timer::time_point::max()}
 	{
 	}
 	~async_cond_var() = default;
@@ -40,8 +46,9 @@ public:
 	COMA_NODISCARD auto async_wait(CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var::async_wait"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
-			detail::run_wait_op{}, token, &m_timer);
+			detail::run_wait_op{}, token, &m_timer, this->monitor());
 	}
 
 	template<class Predicate, class CompletionToken = default_token,
@@ -49,18 +56,62 @@ public:
 	COMA_NODISCARD auto async_wait(Predicate&& pred, CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var::async_wait"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
-			detail::run_wait_pred_op{}, token, &m_timer, std::forward<Predicate>(pred));
+			detail::run_wait_pred_op{}, token, &m_timer, std::forward<Predicate>(pred),
+			this->monitor());
+	}
+
+	// Waits until pred() returns true, pred() is only evaluated again after a
+	// wakeup if generation() advanced since it was last evaluated. Requires
+	// that advance() is called whenever the state pred() depends on changes.
+	template<class Predicate, class CompletionToken = default_token,
+			 typename = typename std::enable_if<detail::is_predicate<Predicate>::value>::type>
+	COMA_NODISCARD auto async_wait_versioned(Predicate&& pred,
+											 CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		BOOST_ASIO_HANDLER_LOCATION(
+			(__FILE__, __LINE__, "coma::async_cond_var::async_wait_versioned"));
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			detail::run_wait_pred_op{}, token, &m_timer,
+			detail::make_versioned_pred(std::forward<Predicate>(pred), &m_generation),
+			this->monitor());
+	}
+
+	void notify_one()
+	{
+		COMA_PROBE2(notify_one, this->monitor(), this->stats().waiters);
+		m_timer.cancel_one();
+	}
+
+	// wakes up to n waiters in FIFO order, returns the number woken
+	std::size_t notify_n(std::size_t n)
+	{
+		COMA_PROBE3(notify_n, this->monitor(), this->stats().waiters, n);
+		std::size_t woken = 0;
+		while (woken < n && m_timer.cancel_one() != 0)
+			++woken;
+		return woken;
+	}
+
+	void notify_all()
+	{
+		COMA_PROBE2(notify_all, this->monitor(), this->stats().waiters);
+		m_timer.cancel();
 	}
 
-	void notify_one() { m_timer.cancel_one(); }
+	// version of the state waited on, see async_wait_versioned()
+	COMA_NODISCARD std::uint64_t generation() const noexcept { return m_generation; }
 
-	void notify_all() { m_timer.cancel(); }
+	// called after changing the state waited on, returns the new generation
+	std::uint64_t advance() noexcept { return ++m_generation; }
 
 	executor_type get_executor() { return m_timer.get_executor(); }
 
 private:
 	timer m_timer;
+	std::uint64_t m_generation{0};
 };
 
 } // namespace coma
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+
+namespace coma {
+
+// When the predicate of a waiting task is evaluated after a notification
+enum class predicate_check
+{
+	// the woken task evaluates it on its own executor and parks again if it
+	// is false, the handler runs with no suspension point after pred() is true
+	on_resume,
+	// notify_one() and notify_all() evaluate it on the notifying thread and
+	// only wake tasks for which it is true, others stay parked. The handler
+	// is posted, so the predicate may no longer hold when it runs.
+	on_notify
+};
+
+// Compact variant of async_cond_var, not thread-safe. Consists of an executor
+// and an intrusive list of waiters, no timer, plus the counters of stats()
+// unless Stats is wait_stats_mode::none. Per waiter state is allocated when a
+// task parks and released when it completes.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR,
+		 predicate_check Check = predicate_check::on_resume,
+		 wait_stats_mode Stats = wait_stats_mode::counted>
+class async_cond_var_compact : public detail::wait_stats_base<Stats>
+{
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using check_on_notify = std::integral_constant<bool, Check == predicate_check::on_notify>;
+	using node_type = typename std::conditional<check_on_notify::value, detail::checked_node,
+												detail::waiter_node>::type;
+	using counters_type = typename detail::wait_stats_base<Stats>::counters_type;
+
+	struct initiate_wait
+	{
+		async_cond_var_compact* self;
+		template<class Handler>
+		void operator()(Handler&& h) const
+		{
+			self->m_waiters.push_back(detail::make_handler_node(
+				std::forward<Handler>(h), self->m_ex,
+				detail::basic_counted_waiter<node_type, counters_type>{self->counters()}));
+		}
+	};
+
+	struct initiate_wait_pred
+	{
+		async_cond_var_compact* self;
+		template<class Handler, class Predicate>
+		void operator()(Handler&& h, Predicate&& pred) const
+		{
+			detail::start_pred_wait<node_type>(
+				std::forward<Handler>(h), self->m_ex, std::forward<Predicate>(pred),
+				detail::list_parker<node_type>{&self->m_waiters}, self->counters());
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_cond_var_compact<E, Check, Stats>;
+	};
+
+	explicit async_cond_var_compact(const executor_type& ex)
+		: m_ex{ex}
+	{
+	}
+	explicit async_cond_var_compact(executor_type&& ex)
+		: m_ex{std::move(ex)}
+	{
+	}
+	// parked waiters complete with operation_aborted
+	~async_cond_var_compact() { m_waiters.abort_all(); }
+	async_cond_var_compact(const async_cond_var_compact&) = delete;
+	async_cond_var_compact& operator=(const async_cond_var_compact&) = delete;
+
+	template<class CompletionToken = default_token,
+			 typename =
+				 typename std::enable_if<!detail::is_predicate<CompletionToken>::value>::type>
+	COMA_NODISCARD auto async_wait(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_wait{this}, token);
+	}
+
+	template<class Predicate, class CompletionToken = default_token,
+			 typename = typename std::enable_if<detail::is_predicate<Predicate>::value>::type>
+	COMA_NODISCARD auto async_wait(Predicate&& pred, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_wait_pred{this}, token, std::forward<Predicate>(pred));
+	}
+
+	// with predicate_check::on_notify, wakes the first task whose predicate is true
+	void notify_one() { notify_one(check_on_notify{}); }
+
+	// with predicate_check::on_notify, wakes the tasks whose predicate is true
+	void notify_all() { notify_all(check_on_notify{}); }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+private:
+	executor_type m_ex;
+	detail::waiter_list<node_type> m_waiters;
+
+	void notify_one(std::false_type)
+	{
+		if (!m_waiters.empty())
+			m_waiters.pop_front()->wake();
+	}
+
+	void notify_one(std::true_type)
+	{
+		for (auto* n = m_waiters.front(); n; n = m_waiters.next(n))
+		{
+			if (n->ready())
+			{
+				m_waiters.erase(n);
+				n->wake();
+				return;
+			}
+		}
+	}
+
+	void notify_all(std::false_type)
+	{
+		while (!m_waiters.empty())
+			m_waiters.pop_front()->wake();
+	}
+
+	// predicates must not call back into the condition variable
+	void notify_all(std::true_type)
+	{
+		auto* n = m_waiters.front();
+		while (n)
+		{
+			auto* next = m_waiters.next(n);
+			if (n->ready())
+			{
+				m_waiters.erase(n);
+				n->wake();
+			}
+			n = next;
+		}
+	}
+};
+
+} // namespace coma
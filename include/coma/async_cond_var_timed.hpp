@@ -10,10 +10,11 @@
 namespace coma {
 
 namespace detail {
-template<class Executor>
-struct cv_timed_impl
+template<class Executor, class Observer>
+struct cv_timed_impl : wait_monitor<Observer>
 {
 	using executor_type = Executor;
+	using observer_type = Observer;
 	using clock = std::chrono::steady_clock;
 	using timer_type =
 		boost::asio::basic_waitable_timer<clock, boost::asio::wait_traits<clock>, Executor>;
@@ -29,11 +30,13 @@ struct cv_timed_impl
 	bool stopped{false};
 
 	explicit cv_timed_impl(const executor_type& ex)
-		: timer{ex, timer_type::time_point::max()}
+		: wait_monitor<Observer>{"async_cond_var_timed"}
+		, timer{ex, timer_type::time_point::max()}
 	{
 	}
 	explicit cv_timed_impl(executor_type&& ex)
-		: timer{std::move(ex), timer_type::time_point::max()}
+		: wait_monitor<Observer>{"async_cond_var_timed"}
+		, timer{std::move(ex), timer_type::time_point::max()}
 	{
 	}
 
@@ -74,10 +77,12 @@ struct cv_timed_impl
 } // namespace detail
 
 // not thread-safe
-template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
+// Observer receives the events of each wait, see null_wait_observer
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Observer = null_wait_observer,
+		 wait_stats_mode Stats = wait_stats_mode::counted>
 class async_cond_var_timed
 {
-	using impl_type = detail::cv_timed_impl<Executor>;
+	using impl_type = detail::cv_timed_impl<Executor, detail::observer_policy<Observer, Stats>>;
 	using clock = std::chrono::steady_clock;
 	using timer = typename impl_type::timer_type;
 	using default_token = typename net::default_completion_token<Executor>::type;
@@ -90,7 +95,7 @@ public:
 	template<class E>
 	struct rebind_executor
 	{
-		using other = async_cond_var_timed<E>;
+		using other = async_cond_var_timed<E, Observer, Stats>;
 	};
 
 	explicit async_cond_var_timed(const executor_type& ex)
@@ -111,6 +116,7 @@ public:
 	COMA_NODISCARD auto async_wait(CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var_timed::async_wait"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
 			detail::run_wait_until_op<false>{}, token, &m_impl, time_point::max());
 	}
@@ -120,6 +126,7 @@ public:
 	COMA_NODISCARD auto async_wait(Predicate&& pred, CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var_timed::async_wait"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
 			detail::run_wait_until_pred_op<false>{}, token, &m_impl, time_point::max(), std::forward<Predicate>(pred));
 	}
@@ -130,6 +137,7 @@ public:
 	COMA_NODISCARD auto async_wait_until(time_point endtime, CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC_AND(cv_status)
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var_timed::async_wait_until"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code, cv_status)>(
 			detail::run_wait_until_op<true>{}, token, &m_impl, endtime);
 	}
@@ -140,6 +148,7 @@ public:
 	COMA_NODISCARD auto async_wait_until(time_point endtime, Predicate&& pred, CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC_AND(bool)
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_cond_var_timed::async_wait_until"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code, bool)>(
 			detail::run_wait_until_pred_op<true>{}, token, &m_impl, endtime, std::forward<Predicate>(pred));
 	}
@@ -162,9 +171,17 @@ public:
 		return async_wait_until(clock_type::now() + dur, std::forward<Predicate>(pred), std::forward<CompletionToken>(token));
 	}
 
-	void notify_one() { m_impl.timer.cancel_one(); }
+	void notify_one()
+	{
+		COMA_PROBE2(notify_one, &m_impl, m_impl.stats().waiters);
+		m_impl.timer.cancel_one();
+	}
 
-	void notify_all() { m_impl.timer.cancel(); }
+	void notify_all()
+	{
+		COMA_PROBE2(notify_all, &m_impl, m_impl.stats().waiters);
+		m_impl.timer.cancel();
+	}
 
 	void stop()
 	{
@@ -181,6 +198,13 @@ public:
 
 	executor_type get_executor() { return m_impl.timer.get_executor(); }
 
+	Observer& observer() noexcept { return m_impl.observer(); }
+	const Observer& observer() const noexcept { return m_impl.observer(); }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_impl.stats(); }
+
+	void set_trace_name(const char* name) noexcept { m_impl.set_trace_name(name); }
+
 private:
 	impl_type m_impl;
 };
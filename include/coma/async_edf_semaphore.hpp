@@ -0,0 +1,248 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <boost/asio/basic_waitable_timer.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+
+namespace coma {
+
+namespace detail {
+
+template<class Clock>
+struct edf_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+	typename Clock::time_point deadline{Clock::time_point::max()};
+};
+
+} // namespace detail
+
+// Semaphore serving waiters by earliest deadline first, not thread-safe.
+// Waiters are kept sorted by deadline, waiters without a deadline and equal
+// deadlines are served in FIFO order. A waiter whose deadline passes while
+// parked completes with boost::asio::error::timed_out (counted as timeout in
+// stats()) instead of taking a permit it could not use in time. Like
+// cv_timed_impl, a single timer is shared by all deadlines, armed for the
+// earliest one and only while a waiter with a deadline is parked.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Clock = std::chrono::steady_clock>
+class async_edf_semaphore
+{
+	using timer = net::basic_waitable_timer<Clock, net::wait_traits<Clock>, Executor>;
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::edf_waiter<Clock>;
+
+	struct initiate_acquire
+	{
+		async_edf_semaphore* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n, typename Clock::time_point deadline) const
+		{
+			self->start_acquire(std::forward<Handler>(h), n, deadline);
+		}
+	};
+
+	// does not keep the semaphore alive, aborted when it is destroyed
+	struct on_timer
+	{
+		async_edf_semaphore* self;
+		void operator()(boost::system::error_code ec) const
+		{
+			if (ec == net::error::operation_aborted)
+				return;
+			self->m_armed = time_point::max();
+			self->expire(Clock::now());
+			// dropped waiters may have blocked later ones
+			self->wake_waiters();
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	using clock_type = Clock;
+	using time_point = typename Clock::time_point;
+	using duration = typename Clock::duration;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_edf_semaphore<E, Clock>;
+	};
+
+	explicit async_edf_semaphore(const executor_type& ex, std::ptrdiff_t init)
+		: m_timer{ex}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	explicit async_edf_semaphore(executor_type&& ex, std::ptrdiff_t init)
+		: m_timer{std::move(ex)}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	// parked waiters complete with operation_aborted
+	~async_edf_semaphore() { m_waiters.abort_all(); }
+	async_edf_semaphore(const async_edf_semaphore&) = delete;
+	async_edf_semaphore& operator=(const async_edf_semaphore&) = delete;
+
+	// acquires without deadline, served after all waiters with one
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1}, time_point::max());
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_until(time_point deadline,
+											CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1}, deadline);
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_for(duration dur, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return async_acquire_until(Clock::now() + dur, std::forward<CompletionToken>(token));
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_n_until(std::ptrdiff_t n, time_point deadline,
+											  CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, n, deadline);
+	}
+
+	// fails if there are waiting tasks
+	COMA_NODISCARD bool try_acquire()
+	{
+		assert(m_counter >= 0);
+		if (m_counter == 0 || !m_waiters.empty())
+		{
+			return false;
+		}
+		--m_counter;
+		m_counters.acquire();
+		return true;
+	}
+
+	void release()
+	{
+		++m_counter;
+		wake_waiters();
+	}
+
+	void release(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		m_counter += n;
+		wake_waiters();
+	}
+
+	executor_type get_executor() { return m_timer.get_executor(); }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	timer m_timer;
+	std::ptrdiff_t m_counter;
+	// expiry of the pending timer wait, max if none
+	time_point m_armed{time_point::max()};
+	detail::wait_counters m_counters;
+	detail::waiter_list<waiter> m_waiters;
+
+	template<class Handler>
+	void start_acquire(Handler&& h, std::ptrdiff_t n, time_point deadline)
+	{
+		if (deadline != time_point::max() && deadline <= Clock::now())
+		{
+			m_counters.timeout();
+			detail::post_completion(std::forward<Handler>(h), m_timer.get_executor(),
+									make_error_code(net::error::timed_out));
+			return;
+		}
+		if (m_waiters.empty() && m_counter >= n)
+		{
+			m_counter -= n;
+			m_counters.acquire();
+			detail::post_completion(std::forward<Handler>(h), m_timer.get_executor(),
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		state.deadline = deadline;
+		m_counters.park();
+		insert(detail::make_handler_node(std::forward<Handler>(h), m_timer.get_executor(), state));
+		arm();
+	}
+
+	// after the last waiter with a deadline not later than w's
+	void insert(waiter* w) noexcept
+	{
+		waiter* pos = nullptr;
+		for (auto* n = m_waiters.back(); n && n->deadline > w->deadline;
+			 n = static_cast<waiter*>(n->prev))
+			pos = n;
+		m_waiters.insert(pos, w);
+	}
+
+	// waits for the earliest deadline, the front waiter
+	void arm()
+	{
+		const auto next = m_waiters.empty() ? time_point::max() : m_waiters.front()->deadline;
+		if (next == m_armed)
+			return;
+		m_armed = next;
+		if (next == time_point::max())
+		{
+			m_timer.cancel();
+			return;
+		}
+		m_timer.expires_at(next);
+		m_timer.async_wait(on_timer{this});
+	}
+
+	void expire(time_point now)
+	{
+		while (!m_waiters.empty() && m_waiters.front()->deadline <= now)
+		{
+			auto* w = m_waiters.pop_front();
+			m_counters.unpark();
+			m_counters.timeout();
+			w->wake(net::error::timed_out);
+		}
+	}
+
+	void wake_waiters()
+	{
+		// permits only go to waiters which can still meet their deadline
+		if (m_armed != time_point::max())
+			expire(Clock::now());
+		while (!m_waiters.empty() && m_waiters.front()->n <= m_counter)
+		{
+			auto* w = m_waiters.pop_front();
+			m_counter -= w->n;
+			m_counters.unpark();
+			m_counters.wakeup();
+			m_counters.acquire();
+			w->wake();
+		}
+		arm();
+	}
+};
+
+} // namespace coma
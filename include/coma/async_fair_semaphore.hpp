@@ -0,0 +1,256 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace coma {
+
+namespace detail {
+
+struct fair_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+};
+
+// waiters of a tenant, linked into the round robin while non-empty
+template<class Key>
+struct fair_queue
+{
+	// key of the map entry owning the queue
+	const Key* key{nullptr};
+	waiter_list<fair_waiter> waiters;
+	std::ptrdiff_t deficit{0};
+	std::ptrdiff_t quantum{1};
+	fair_queue* next{nullptr};
+};
+
+} // namespace detail
+
+// Semaphore sharing permits fairly between tenants, not thread-safe. Each
+// tenant key has its own FIFO queue of waiters and released permits are
+// granted by deficit round robin over the tenants with waiters, a tenant of
+// weight w receives w permits per round. Without waiting tasks acquires do
+// not look up their tenant. Queues are created when the first task of a key
+// parks and removed when the last one is granted, so the number of tenants
+// is unbounded. Weights are kept for the lifetime of the semaphore.
+template<class Key, class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Hash = std::hash<Key>,
+		 class KeyEqual = std::equal_to<Key>>
+class async_fair_semaphore
+{
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::fair_waiter;
+	using queue = detail::fair_queue<Key>;
+
+	struct initiate_acquire
+	{
+		async_fair_semaphore* self;
+		template<class Handler>
+		void operator()(Handler&& h, const Key& key, std::ptrdiff_t n) const
+		{
+			self->start_acquire(std::forward<Handler>(h), key, n);
+		}
+	};
+
+public:
+	using key_type = Key;
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_fair_semaphore<Key, E, Hash, KeyEqual>;
+	};
+
+	explicit async_fair_semaphore(const executor_type& ex, std::ptrdiff_t init)
+		: m_ex{ex}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	explicit async_fair_semaphore(executor_type&& ex, std::ptrdiff_t init)
+		: m_ex{std::move(ex)}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	// parked waiters complete with operation_aborted
+	~async_fair_semaphore()
+	{
+		for (auto& kv : m_queues)
+			kv.second.waiters.abort_all();
+	}
+	async_fair_semaphore(const async_fair_semaphore&) = delete;
+	async_fair_semaphore& operator=(const async_fair_semaphore&) = delete;
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(const Key& key, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, key, std::ptrdiff_t{1});
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_n(const Key& key, std::ptrdiff_t n,
+										CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, key, n);
+	}
+
+	// fails if there are waiting tasks of any tenant
+	COMA_NODISCARD bool try_acquire()
+	{
+		assert(m_counter >= 0);
+		if (m_counter == 0 || m_head)
+		{
+			return false;
+		}
+		--m_counter;
+		m_counters.acquire();
+		return true;
+	}
+
+	void release()
+	{
+		++m_counter;
+		wake_waiters();
+	}
+
+	void release(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		m_counter += n;
+		wake_waiters();
+	}
+
+	// permits granted to the tenant per round, 1 by default, applies from
+	// the next turn of the tenant
+	void set_weight(const Key& key, std::ptrdiff_t weight)
+	{
+		assert(weight > 0);
+		m_weights[key] = weight;
+		auto it = m_queues.find(key);
+		if (it != m_queues.end())
+			it->second.quantum = weight;
+	}
+
+	COMA_NODISCARD std::ptrdiff_t weight(const Key& key) const
+	{
+		auto it = m_weights.find(key);
+		return it == m_weights.end() ? 1 : it->second;
+	}
+
+	// number of tenants with waiting tasks
+	COMA_NODISCARD std::size_t tenant_count() const noexcept { return m_queues.size(); }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	executor_type m_ex;
+	std::ptrdiff_t m_counter;
+	std::unordered_map<Key, queue, Hash, KeyEqual> m_queues;
+	std::unordered_map<Key, std::ptrdiff_t, Hash, KeyEqual> m_weights;
+	// round robin of the queues with waiters, the head is served
+	queue* m_head{nullptr};
+	queue* m_tail{nullptr};
+	detail::wait_counters m_counters;
+
+	template<class Handler>
+	void start_acquire(Handler&& h, const Key& key, std::ptrdiff_t n)
+	{
+		if (!m_head && m_counter >= n)
+		{
+			m_counter -= n;
+			m_counters.acquire();
+			detail::post_completion(std::forward<Handler>(h), m_ex,
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		m_counters.park();
+		auto it = m_queues.find(key);
+		if (it == m_queues.end())
+		{
+			it = m_queues.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+								  std::forward_as_tuple())
+					 .first;
+			it->second.key = &it->first;
+			it->second.quantum = weight(key);
+			push_back(&it->second);
+		}
+		it->second.waiters.push_back(
+			detail::make_handler_node(std::forward<Handler>(h), m_ex, state));
+	}
+
+	// a queue receives its quantum when its turn starts
+	void push_back(queue* q) noexcept
+	{
+		q->next = nullptr;
+		if (m_tail)
+			m_tail->next = q;
+		else
+		{
+			m_head = q;
+			q->deficit += q->quantum;
+		}
+		m_tail = q;
+	}
+
+	queue* pop_front() noexcept
+	{
+		auto* q = m_head;
+		m_head = q->next;
+		if (!m_head)
+			m_tail = nullptr;
+		else
+			m_head->deficit += m_head->quantum;
+		q->next = nullptr;
+		return q;
+	}
+
+	void wake_waiters()
+	{
+		while (m_head)
+		{
+			auto* q = m_head;
+			auto* w = q->waiters.front();
+			if (w->n > q->deficit)
+			{
+				// turn is over, the deficit carries over to the next round
+				push_back(pop_front());
+				continue;
+			}
+			if (w->n > m_counter)
+				break;
+			q->waiters.pop_front();
+			q->deficit -= w->n;
+			m_counter -= w->n;
+			if (q->waiters.empty())
+			{
+				pop_front();
+				m_queues.erase(m_queues.find(*q->key));
+			}
+			m_counters.unpark();
+			m_counters.wakeup();
+			m_counters.acquire();
+			w->wake();
+		}
+	}
+};
+
+} // namespace coma
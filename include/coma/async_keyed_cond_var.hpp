@@ -0,0 +1,151 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+
+#include <functional>
+#include <unordered_map>
+
+namespace coma {
+
+// Condition variable with a queue of waiters per key, not thread-safe.
+// Notifications only wake the waiters of the given key, such that
+// many tasks waiting for different conditions can share one primitive
+// without waking each other. Queues are created when the first task
+// of a key parks and removed when the last one is woken.
+template<class Key, class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Hash = std::hash<Key>,
+		 class KeyEqual = std::equal_to<Key>>
+class async_keyed_cond_var
+{
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using map_type = std::unordered_map<Key, detail::waiter_list<>, Hash, KeyEqual>;
+
+	// predicate waits are parked again under their key
+	struct key_parker
+	{
+		async_keyed_cond_var* self;
+		Key key;
+		void operator()(detail::waiter_node* n) const { self->m_waiters[key].push_back(n); }
+	};
+
+	struct initiate_wait
+	{
+		async_keyed_cond_var* self;
+		template<class Handler>
+		void operator()(Handler&& h, const Key& key) const
+		{
+			self->m_waiters[key].push_back(detail::make_handler_node(
+				std::forward<Handler>(h), self->m_ex, detail::counted_waiter{&self->m_counters}));
+		}
+	};
+
+	struct initiate_wait_pred
+	{
+		async_keyed_cond_var* self;
+		template<class Handler, class Predicate>
+		void operator()(Handler&& h, const Key& key, Predicate&& pred) const
+		{
+			detail::start_pred_wait(std::forward<Handler>(h), self->m_ex,
+									std::forward<Predicate>(pred), key_parker{self, key},
+									&self->m_counters);
+		}
+	};
+
+public:
+	using key_type = Key;
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_keyed_cond_var<Key, E, Hash, KeyEqual>;
+	};
+
+	explicit async_keyed_cond_var(const executor_type& ex)
+		: m_ex{ex}
+	{
+	}
+	explicit async_keyed_cond_var(executor_type&& ex)
+		: m_ex{std::move(ex)}
+	{
+	}
+	// parked waiters complete with operation_aborted
+	~async_keyed_cond_var()
+	{
+		for (auto& kv : m_waiters)
+			kv.second.abort_all();
+	}
+	async_keyed_cond_var(const async_keyed_cond_var&) = delete;
+	async_keyed_cond_var& operator=(const async_keyed_cond_var&) = delete;
+
+	template<class CompletionToken = default_token,
+			 typename =
+				 typename std::enable_if<!detail::is_predicate<CompletionToken>::value>::type>
+	COMA_NODISCARD auto async_wait(const Key& key, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_wait{this}, token, key);
+	}
+
+	template<class Predicate, class CompletionToken = default_token,
+			 typename = typename std::enable_if<detail::is_predicate<Predicate>::value>::type>
+	COMA_NODISCARD auto async_wait(const Key& key, Predicate&& pred,
+								   CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_wait_pred{this}, token, key, std::forward<Predicate>(pred));
+	}
+
+	void notify_one(const Key& key)
+	{
+		auto it = m_waiters.find(key);
+		if (it == m_waiters.end())
+			return;
+		auto* w = it->second.pop_front();
+		if (it->second.empty())
+			m_waiters.erase(it);
+		w->wake();
+	}
+
+	void notify_all(const Key& key)
+	{
+		auto it = m_waiters.find(key);
+		if (it == m_waiters.end())
+			return;
+		// woken predicate waits may park under key again
+		detail::waiter_list<> woken;
+		while (!it->second.empty())
+			woken.push_back(it->second.pop_front());
+		m_waiters.erase(it);
+		while (!woken.empty())
+			woken.pop_front()->wake();
+	}
+
+	// wakes the waiters of all keys
+	void notify_all()
+	{
+		map_type woken;
+		woken.swap(m_waiters);
+		for (auto& kv : woken)
+		{
+			while (!kv.second.empty())
+				kv.second.pop_front()->wake();
+		}
+	}
+
+	// number of keys with waiting tasks
+	COMA_NODISCARD std::size_t key_count() const noexcept { return m_waiters.size(); }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	executor_type m_ex;
+	map_type m_waiters;
+	detail::wait_counters m_counters;
+};
+
+} // namespace coma
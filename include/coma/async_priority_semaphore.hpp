@@ -0,0 +1,229 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdint>
+#include <vector>
+
+namespace coma {
+
+namespace detail {
+
+struct prio_sem_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+	// number of grants when the waiter parked, used for aging
+	std::uint64_t ticket{0};
+	// park order across levels
+	std::uint64_t seq{0};
+};
+
+} // namespace detail
+
+// Semaphore with a number of priority levels, not thread-safe. Level 0 is
+// the highest priority, each level has its own FIFO queue of waiters and
+// released permits go to the front waiter of the highest non-empty level.
+// With aging != 0 a parked waiter is promoted by one level for every aging
+// permit grants to other waiters, such that low priorities do not starve.
+// Like async_semaphore_compact, state for a waiter is only allocated while
+// it is parked and permits are handed directly to waiters.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
+class async_priority_semaphore
+{
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::prio_sem_waiter;
+
+	struct initiate_acquire
+	{
+		async_priority_semaphore* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n, std::size_t prio) const
+		{
+			self->start_acquire(std::forward<Handler>(h), n, prio);
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_priority_semaphore<E>;
+	};
+
+	async_priority_semaphore(const executor_type& ex, std::ptrdiff_t init, std::size_t levels,
+							 std::uint64_t aging = 0)
+		: m_ex{ex}
+		, m_counter{init}
+		, m_aging{aging}
+		, m_waiters(levels == 0 ? 1 : levels)
+	{
+		assert(0 <= m_counter);
+	}
+	async_priority_semaphore(executor_type&& ex, std::ptrdiff_t init, std::size_t levels,
+							 std::uint64_t aging = 0)
+		: m_ex{std::move(ex)}
+		, m_counter{init}
+		, m_aging{aging}
+		, m_waiters(levels == 0 ? 1 : levels)
+	{
+		assert(0 <= m_counter);
+	}
+	// parked waiters complete with operation_aborted
+	~async_priority_semaphore()
+	{
+		for (auto& waiters : m_waiters)
+			waiters.abort_all();
+	}
+	async_priority_semaphore(const async_priority_semaphore&) = delete;
+	async_priority_semaphore& operator=(const async_priority_semaphore&) = delete;
+
+	// acquires with the lowest priority
+	template<class CompletionToken = default_token,
+			 typename = typename std::enable_if<
+				 !std::is_integral<typename std::decay<CompletionToken>::type>::value>::type>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1}, levels() - 1);
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(std::size_t prio, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(prio < levels());
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1}, prio);
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_n(std::ptrdiff_t n, std::size_t prio,
+										CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		assert(prio < levels());
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, n, prio);
+	}
+
+	// fails if there are waiting tasks of any level, they are served first
+	COMA_NODISCARD bool try_acquire()
+	{
+		assert(m_counter >= 0);
+		if (m_counter == 0 || m_parked != 0)
+		{
+			return false;
+		}
+		--m_counter;
+		m_counters.acquire();
+		return true;
+	}
+
+	void release()
+	{
+		++m_counter;
+		wake_waiters();
+	}
+
+	void release(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		m_counter += n;
+		wake_waiters();
+	}
+
+	COMA_NODISCARD std::size_t levels() const noexcept { return m_waiters.size(); }
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	executor_type m_ex;
+	std::ptrdiff_t m_counter;
+	std::uint64_t m_aging;
+	std::uint64_t m_grants{0};
+	std::uint64_t m_seq{0};
+	std::size_t m_parked{0};
+	detail::wait_counters m_counters;
+	std::vector<detail::waiter_list<waiter>> m_waiters;
+
+	template<class Handler>
+	void start_acquire(Handler&& h, std::ptrdiff_t n, std::size_t prio)
+	{
+		if (m_parked == 0 && m_counter >= n)
+		{
+			m_counter -= n;
+			m_counters.acquire();
+			detail::post_completion(std::forward<Handler>(h), m_ex,
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		state.ticket = m_grants;
+		state.seq = m_seq++;
+		m_counters.park();
+		m_waiters[prio].push_back(
+			detail::make_handler_node(std::forward<Handler>(h), m_ex, state));
+		++m_parked;
+	}
+
+	// level of the front waiter of level after aging
+	std::size_t effective_level(std::size_t level) const noexcept
+	{
+		const auto promoted = (m_grants - m_waiters[level].front()->ticket) / m_aging;
+		return promoted >= level ? 0 : level - static_cast<std::size_t>(promoted);
+	}
+
+	// queue to serve next, ties of the effective level go to the older waiter
+	detail::waiter_list<waiter>* next_queue() noexcept
+	{
+		detail::waiter_list<waiter>* best = nullptr;
+		std::size_t best_level = 0;
+		for (std::size_t level = 0; level < m_waiters.size(); ++level)
+		{
+			auto& q = m_waiters[level];
+			if (q.empty())
+				continue;
+			if (m_aging == 0)
+				return &q;
+			const auto eff = effective_level(level);
+			if (!best || eff < best_level ||
+				(eff == best_level && q.front()->seq < best->front()->seq))
+			{
+				best = &q;
+				best_level = eff;
+			}
+		}
+		return best;
+	}
+
+	void wake_waiters()
+	{
+		while (m_parked != 0)
+		{
+			auto* q = next_queue();
+			if (q->front()->n > m_counter)
+				break;
+			auto* w = q->pop_front();
+			--m_parked;
+			++m_grants;
+			m_counter -= w->n;
+			m_counters.unpark();
+			m_counters.wakeup();
+			m_counters.acquire();
+			w->wake();
+		}
+	}
+};
+
+} // namespace coma
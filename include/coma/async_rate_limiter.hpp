@@ -0,0 +1,203 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+
+#include <boost/asio/basic_waitable_timer.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+
+namespace coma {
+
+namespace detail {
+
+struct rate_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+};
+
+} // namespace detail
+
+// Token bucket rate limiter, not thread-safe. Tokens are added continuously
+// at rate per second up to burst, acquires wait in FIFO order until enough
+// tokens are available. The bucket is refilled lazily from the time elapsed,
+// a single timer is only armed while tasks wait, for the time the first
+// waiter becomes eligible, so an idle limiter has no pending operations.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
+class async_rate_limiter
+{
+	using clock = std::chrono::steady_clock;
+	using timer = net::basic_waitable_timer<clock, net::wait_traits<clock>, Executor>;
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::rate_waiter;
+
+	struct initiate_acquire
+	{
+		async_rate_limiter* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n) const
+		{
+			self->start_acquire(std::forward<Handler>(h), n);
+		}
+	};
+
+	// does not keep the limiter alive, aborted when it is destroyed
+	struct on_timer
+	{
+		async_rate_limiter* self;
+		void operator()(boost::system::error_code ec) const
+		{
+			if (ec == net::error::operation_aborted)
+				return;
+			self->wake_waiters();
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_rate_limiter<E>;
+	};
+
+	// rate in tokens per second, the bucket starts full
+	async_rate_limiter(const executor_type& ex, double rate, std::ptrdiff_t burst)
+		: m_timer{ex}
+		, m_rate{rate}
+		, m_burst{static_cast<double>(burst)}
+		, m_tokens{m_burst}
+		, m_last{clock::now()}
+	{
+		assert(rate > 0);
+		assert(burst > 0);
+	}
+	// parked waiters complete with operation_aborted
+	~async_rate_limiter() { m_waiters.abort_all(); }
+	async_rate_limiter(const async_rate_limiter&) = delete;
+	async_rate_limiter& operator=(const async_rate_limiter&) = delete;
+
+	template<class CompletionToken = default_token,
+			 typename = typename std::enable_if<
+				 !std::is_integral<typename std::decay<CompletionToken>::type>::value>::type>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1});
+	}
+
+	// n must not exceed burst
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(std::ptrdiff_t n, CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		assert(static_cast<double>(n) <= m_burst);
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, n);
+	}
+
+	// fails if there are waiting tasks, to keep FIFO order
+	COMA_NODISCARD bool try_acquire(std::ptrdiff_t n = 1)
+	{
+		refill(clock::now());
+		if (!m_waiters.empty() || m_tokens < static_cast<double>(n))
+			return false;
+		m_tokens -= static_cast<double>(n);
+		m_counters.acquire();
+		return true;
+	}
+
+	// tokens currently in the bucket
+	COMA_NODISCARD double tokens() const noexcept
+	{
+		const auto elapsed = std::chrono::duration<double>(clock::now() - m_last).count();
+		const auto t = m_tokens + elapsed * m_rate;
+		return t < m_burst ? t : m_burst;
+	}
+
+	COMA_NODISCARD double rate() const noexcept { return m_rate; }
+	COMA_NODISCARD std::ptrdiff_t burst() const noexcept
+	{
+		return static_cast<std::ptrdiff_t>(m_burst);
+	}
+
+	executor_type get_executor() { return m_timer.get_executor(); }
+
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+private:
+	timer m_timer;
+	double m_rate;
+	double m_burst;
+	double m_tokens;
+	clock::time_point m_last;
+	detail::wait_counters m_counters;
+	detail::waiter_list<waiter> m_waiters;
+
+	void refill(clock::time_point now) noexcept
+	{
+		const auto elapsed = std::chrono::duration<double>(now - m_last).count();
+		m_last = now;
+		m_tokens += elapsed * m_rate;
+		if (m_tokens > m_burst)
+			m_tokens = m_burst;
+	}
+
+	template<class Handler>
+	void start_acquire(Handler&& h, std::ptrdiff_t n)
+	{
+		const auto now = clock::now();
+		refill(now);
+		if (m_waiters.empty() && m_tokens >= static_cast<double>(n))
+		{
+			m_tokens -= static_cast<double>(n);
+			m_counters.acquire();
+			detail::post_completion(std::forward<Handler>(h), m_timer.get_executor(),
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		m_counters.park();
+		m_waiters.push_back(
+			detail::make_handler_node(std::forward<Handler>(h), m_timer.get_executor(), state));
+		// the timer is armed for the first waiter only
+		if (m_waiters.front() == m_waiters.back())
+			arm(now);
+	}
+
+	// time the first waiter becomes eligible
+	void arm(clock::time_point now)
+	{
+		const auto missing = static_cast<double>(m_waiters.front()->n) - m_tokens;
+		const auto wait = std::chrono::duration_cast<clock::duration>(
+			std::chrono::duration<double>(missing / m_rate));
+		m_timer.expires_at(now + wait + clock::duration{1});
+		m_timer.async_wait(on_timer{this});
+	}
+
+	void wake_waiters()
+	{
+		const auto now = clock::now();
+		refill(now);
+		while (!m_waiters.empty() &&
+			   static_cast<double>(m_waiters.front()->n) <= m_tokens)
+		{
+			auto* w = m_waiters.pop_front();
+			m_tokens -= static_cast<double>(w->n);
+			m_counters.unpark();
+			m_counters.wakeup();
+			m_counters.acquire();
+			w->wake();
+		}
+		if (!m_waiters.empty())
+			arm(now);
+	}
+};
+
+} // namespace coma
@@ -2,20 +2,82 @@
 
 #include <coma/detail/core_async.hpp>
 #include <coma/detail/wait_ops.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/error.hpp>
 #include <coma/semaphore_guards.hpp>
 
 #include <boost/asio/basic_waitable_timer.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cinttypes>
+#include <limits>
 
 namespace coma {
 
 namespace detail {
 
+// acquires admitted by the max waiters check which have not completed,
+// their permits are only taken by the posted check of the operation
+struct pending_acquires
+{
+	std::ptrdiff_t count{0};
+	// permits they take at most, n for async_acquire_up_to(n)
+	std::ptrdiff_t permits{0};
+
+	void add(std::ptrdiff_t n) noexcept
+	{
+		++count;
+		permits += n;
+	}
+	void remove(std::ptrdiff_t n) noexcept
+	{
+		--count;
+		permits -= n;
+	}
+};
+
+// Entry of an admitted acquire in pending_acquires, held by its operation.
+// Removed when the acquire takes its permits, or when the operation is
+// destroyed without (completed with an error, or its executor shut down).
+class pending_entry
+{
+public:
+	pending_entry() = default;
+	pending_entry(pending_entry&& other) noexcept
+		: m_pending{exchange(other.m_pending, nullptr)}
+		, m_permits{other.m_permits}
+	{
+	}
+	pending_entry& operator=(pending_entry&&) = delete;
+	~pending_entry() { done(); }
+
+	void track(pending_acquires* pending, std::ptrdiff_t permits) noexcept
+	{
+		assert(m_pending == nullptr);
+		m_pending = pending;
+		m_permits = permits;
+		m_pending->add(permits);
+	}
+
+	void done() noexcept
+	{
+		if (m_pending != nullptr)
+		{
+			m_pending->remove(m_permits);
+			m_pending = nullptr;
+		}
+	}
+
+private:
+	pending_acquires* m_pending{nullptr};
+	std::ptrdiff_t m_permits{0};
+};
+
 struct acq_pred
 {
 	std::ptrdiff_t* counter;
+	pending_entry entry;
 	bool operator()() noexcept
 	{
 		assert(*counter >= 0);
@@ -26,6 +88,7 @@ struct acq_pred
 		// successful completion handler called
 		// if and only if pred() is true
 		--(*counter);
+		entry.done();
 		return true;
 	}
 };
@@ -33,6 +96,7 @@ struct acq_pred
 struct acq_pred_n
 {
 	std::ptrdiff_t* counter;
+	pending_entry entry;
 	std::ptrdiff_t n;
 	bool operator()() noexcept
 	{
@@ -44,40 +108,113 @@ struct acq_pred_n
 		// successful completion handler called
 		// if and only if pred() is true
 		*counter -= n;
+		entry.done();
 		return true;
 	}
 };
 
+// takes between 1 and n permits, as many as available, 0 if none
+struct acq_up_to
+{
+	std::ptrdiff_t* counter;
+	pending_entry entry;
+	std::ptrdiff_t n;
+	std::ptrdiff_t operator()() noexcept
+	{
+		assert(*counter >= 0);
+		const auto granted = *counter < n ? *counter : n;
+		if (granted == 0)
+		{
+			return 0;
+		}
+		*counter -= granted;
+		entry.done();
+		return granted;
+	}
+};
+
 } // namespace detail
 
-template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
-class async_semaphore
+// Observer receives the events of each wait, see null_wait_observer
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR, class Observer = null_wait_observer,
+		 wait_stats_mode Stats = wait_stats_mode::counted>
+class async_semaphore : public detail::wait_monitor<detail::observer_policy<Observer, Stats>>
 {
+	using monitor_type = detail::wait_monitor<detail::observer_policy<Observer, Stats>>;
+
 	// TODO try implementing without a timer, since we can
 	// never timeout, using a list of handlers functions
 	using clock = std::chrono::steady_clock;
 	using timer = net::basic_waitable_timer<clock, net::wait_traits<clock>, Executor>;
 	using default_token = typename net::default_completion_token<Executor>::type;
 
+	struct initiate_acquire
+	{
+		async_semaphore* self;
+		template<class Handler, class Predicate>
+		void operator()(Handler&& h, Predicate pred, std::ptrdiff_t n) const
+		{
+			if (!self->admit(n))
+			{
+				self->counters()->rejection();
+				detail::post_completion(std::forward<Handler>(h), self->m_timer.get_executor(),
+										make_error_code(error::queue_full));
+				return;
+			}
+			// acquires of no permits never wait
+			if (n > 0)
+				pred.entry.track(&self->m_pending, n);
+			detail::run_wait_pred_op{}(std::forward<Handler>(h), &self->m_timer, std::move(pred),
+									   self->monitor());
+		}
+	};
+
+	struct initiate_acquire_up_to
+	{
+		async_semaphore* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n) const
+		{
+			// waits only without any permit, but may take n from later acquires
+			if (!self->admit(1))
+			{
+				self->counters()->rejection();
+				detail::post_completion(std::forward<Handler>(h), self->m_timer.get_executor(),
+										make_error_code(error::queue_full), std::ptrdiff_t{0});
+				return;
+			}
+			detail::acq_up_to grant{&self->m_counter, {}, n};
+			grant.entry.track(&self->m_pending, n);
+			detail::run_wait_up_to_op{}(std::forward<Handler>(h), &self->m_timer, std::move(grant),
+										self->monitor());
+		}
+	};
+
 public:
 	using executor_type = Executor;
 	template<class E>
 	struct rebind_executor
 	{
-		using other = async_semaphore<E>;
+		using other = async_semaphore<E, Observer, Stats>;
 	};
 
 	explicit async_semaphore(const executor_type& ex, std::ptrdiff_t init)
-		: m_timer{ex, timer::time_point::max()}
+		: monitor_type{"async_semaphore"}
+		, m_timer{ex, timer::time_point::max()}
 		, m_counter{init}
+		, m_capacity{init}
 	{
 		assert(0 <= m_counter);
+		this->watch_permits(&m_counter);
 	}
 	explicit async_semaphore(executor_type&& ex, std::ptrdiff_t init)
-		: m_timer{std::move(ex), timer::time_point::max()}
+		: monitor_type{"async_semaphore"}
+		, m_timer{std::move(ex), timer::time_point::max()}
 		, m_counter{init}
+		, m_capacity{init}
 	{
 		assert(0 <= m_counter);
+		this->watch_permits(&m_counter);
 	}
 	~async_semaphore() = default;
 	async_semaphore(const async_semaphore&) = delete;
@@ -87,8 +224,9 @@ public:
 	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
 		-> COMA_ASYNC_RETURN_EC
 	{
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_semaphore::async_acquire"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
-			detail::run_wait_pred_op{}, token, &m_timer, detail::acq_pred{&m_counter});
+			initiate_acquire{this}, token, detail::acq_pred{&m_counter, {}}, std::ptrdiff_t{1});
 	}
 
 	template<class CompletionToken = default_token>
@@ -97,8 +235,24 @@ public:
 		-> COMA_ASYNC_RETURN_EC
 	{
 		assert(n >= 0);
+		BOOST_ASIO_HANDLER_LOCATION((__FILE__, __LINE__, "coma::async_semaphore::async_acquire_n"));
 		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
-			detail::run_wait_pred_op{}, token, &m_timer, detail::acq_pred_n{&m_counter, n});
+			initiate_acquire{this}, token, detail::acq_pred_n{&m_counter, {}, n}, n);
+	}
+
+	// waits until at least one permit is available and takes up to n,
+	// completes with the number of permits taken
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_up_to(std::ptrdiff_t n,
+											CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC_AND(std::ptrdiff_t)
+	{
+		assert(n >= 1);
+		BOOST_ASIO_HANDLER_LOCATION(
+			(__FILE__, __LINE__, "coma::async_semaphore::async_acquire_up_to"));
+		return net::async_initiate<CompletionToken,
+								   void(boost::system::error_code, std::ptrdiff_t)>(
+			initiate_acquire_up_to{this}, token, n);
 	}
 
 	COMA_NODISCARD bool try_acquire()
@@ -109,28 +263,151 @@ public:
 			return false;
 		}
 		--m_counter;
+		this->counters()->acquire();
+		return true;
+	}
+
+	COMA_NODISCARD bool try_acquire_n(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		if (m_counter < n)
+		{
+			return false;
+		}
+		m_counter -= n;
+		this->counters()->acquire();
 		return true;
 	}
 
+	// takes as many permits as available up to n, returns the number taken
+	COMA_NODISCARD std::ptrdiff_t try_acquire_up_to(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		const auto granted = std::min(m_counter, n);
+		if (granted == 0)
+		{
+			return 0;
+		}
+		m_counter -= granted;
+		this->counters()->acquire();
+		return granted;
+	}
+
+	// Releasing more permits than are acquired adds the excess to capacity()
 	void release()
 	{
+		count_release(1);
+		if (m_debt > 0)
+		{
+			--m_debt;
+			return;
+		}
 		++m_counter;
-		m_timer.cancel_one();
+		COMA_PROBE3(release, this->monitor(), 1, this->stats().waiters);
+		wake(1);
 	}
 
 	void release(std::ptrdiff_t n)
 	{
 		assert(n >= 0);
+		count_release(n);
+		const auto paid = std::min(n, m_debt);
+		m_debt -= paid;
+		n -= paid;
 		m_counter += n;
-		if (n == 1)
-			m_timer.cancel_one();
-		else if (n > 1)
-			m_timer.cancel(); // may result in spurious wakeup in acquire
+		COMA_PROBE3(release, this->monitor(), n, this->stats().waiters);
+		wake(n);
+	}
+
+	// Changes the number of permits to capacity, the ones acquired included.
+	// Growing wakes waiters for the permits added. Shrinking takes available
+	// permits and records the rest as debt, which the following releases pay
+	// back before waiters are woken.
+	void set_capacity(std::ptrdiff_t capacity)
+	{
+		assert(capacity >= 0);
+		auto delta = capacity - m_capacity;
+		m_capacity = capacity;
+		if (delta < 0)
+		{
+			const auto taken = std::min(-delta, m_counter);
+			m_counter -= taken;
+			m_debt += -delta - taken;
+			return;
+		}
+		const auto paid = std::min(delta, m_debt);
+		m_debt -= paid;
+		delta -= paid;
+		m_counter += delta;
+		wake(delta);
 	}
 
+	// initial permits, changed by set_capacity() and by releases of more
+	// permits than acquired
+	COMA_NODISCARD std::ptrdiff_t capacity() const noexcept { return m_capacity; }
+
+	// releases which do not return a permit, after shrinking
+	COMA_NODISCARD std::ptrdiff_t debt() const noexcept { return m_debt; }
+
+	// permits which can be acquired without waiting
+	COMA_NODISCARD std::ptrdiff_t available() const noexcept { return m_counter; }
+
+	// Acquires which would wait while max waiters are already waiting complete
+	// immediately with coma::error::queue_full instead, unbounded by default
+	void set_max_waiters(std::uint64_t max) noexcept { m_max_waiters = max; }
+	COMA_NODISCARD std::uint64_t max_waiters() const noexcept { return m_max_waiters; }
+
+	executor_type get_executor() { return m_timer.get_executor(); }
+
 private:
 	timer m_timer;
 	std::ptrdiff_t m_counter;
+	std::ptrdiff_t m_capacity;
+	std::ptrdiff_t m_debt{0};
+	std::uint64_t m_max_waiters{std::numeric_limits<std::uint64_t>::max()};
+	detail::pending_acquires m_pending;
+
+	// permits acquired and not released yet, as capacity includes them
+	COMA_NODISCARD std::ptrdiff_t held() const noexcept { return m_capacity - m_counter + m_debt; }
+
+	void count_release(std::ptrdiff_t n) noexcept
+	{
+		const auto excess = n - held();
+		if (excess > 0)
+			m_capacity += excess;
+	}
+
+	// Wakes waiters for n added permits, one per permit while each pending
+	// acquire takes a single one. Otherwise an acquire_n could take a wakeup
+	// and park again while a waiter behind it would complete, so all are
+	// woken, also for async_acquire_up_to which may take more than needed.
+	void wake(std::ptrdiff_t n)
+	{
+		if (n <= 0)
+			return;
+		if (m_pending.permits > m_pending.count)
+		{
+			m_timer.cancel(); // may result in spurious wakeups in acquire
+			return;
+		}
+		for (; n > 0 && m_timer.cancel_one() != 0; --n)
+		{
+		}
+	}
+
+	// Admitted acquires take their permits in a posted check, so neither the
+	// counter nor the parked waiters tell yet which of them will wait. The
+	// pending ones are assumed to be served in order, as many as the counter
+	// covers, but at least one waits if they need more permits than available.
+	bool admit(std::ptrdiff_t n) const noexcept
+	{
+		if (m_counter >= m_pending.permits + n)
+			return true;
+		const auto served = m_counter >= m_pending.permits
+								? m_pending.count
+								: std::min(m_pending.count - 1, m_counter);
+		return static_cast<std::uint64_t>(m_pending.count - served) < m_max_waiters;
+	}
 };
 
 } // namespace coma
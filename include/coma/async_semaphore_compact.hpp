@@ -0,0 +1,152 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+#include <coma/detail/waiter_list.hpp>
+#include <coma/semaphore_guards.hpp>
+
+#include <cassert>
+#include <cinttypes>
+
+namespace coma {
+
+namespace detail {
+
+struct sem_waiter : waiter_node
+{
+	std::ptrdiff_t n{1};
+};
+
+} // namespace detail
+
+// Compact variant of async_semaphore, not thread-safe. Consists of an executor,
+// a counter and an intrusive list of waiters, no timer, plus the counters of
+// stats() unless Stats is wait_stats_mode::none. Per waiter state is
+// allocated when a task parks and released when it is woken. Permits are handed
+// directly to waiters on release, in strict FIFO order, so there are no
+// spurious wakeups.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR,
+		 wait_stats_mode Stats = wait_stats_mode::counted>
+class async_semaphore_compact : public detail::wait_stats_base<Stats>
+{
+	using default_token = typename net::default_completion_token<Executor>::type;
+	using waiter = detail::sem_waiter;
+
+	struct initiate_acquire
+	{
+		async_semaphore_compact* self;
+		template<class Handler>
+		void operator()(Handler&& h, std::ptrdiff_t n) const
+		{
+			self->start_acquire(std::forward<Handler>(h), n);
+		}
+	};
+
+public:
+	using executor_type = Executor;
+	template<class E>
+	struct rebind_executor
+	{
+		using other = async_semaphore_compact<E, Stats>;
+	};
+
+	explicit async_semaphore_compact(const executor_type& ex, std::ptrdiff_t init)
+		: m_ex{ex}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	explicit async_semaphore_compact(executor_type&& ex, std::ptrdiff_t init)
+		: m_ex{std::move(ex)}
+		, m_counter{init}
+	{
+		assert(0 <= m_counter);
+	}
+	// parked waiters complete with operation_aborted
+	~async_semaphore_compact() { m_waiters.abort_all(); }
+	async_semaphore_compact(const async_semaphore_compact&) = delete;
+	async_semaphore_compact& operator=(const async_semaphore_compact&) = delete;
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire(CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, std::ptrdiff_t{1});
+	}
+
+	template<class CompletionToken = default_token>
+	COMA_NODISCARD auto async_acquire_n(std::ptrdiff_t n,
+										CompletionToken&& token = default_token{})
+		-> COMA_ASYNC_RETURN_EC
+	{
+		assert(n >= 0);
+		return net::async_initiate<CompletionToken, void(boost::system::error_code)>(
+			initiate_acquire{this}, token, n);
+	}
+
+	// fails if there are waiting tasks, to keep FIFO order
+	COMA_NODISCARD bool try_acquire()
+	{
+		assert(m_counter >= 0);
+		if (m_counter == 0 || !m_waiters.empty())
+		{
+			return false;
+		}
+		--m_counter;
+		this->counters()->acquire();
+		return true;
+	}
+
+	void release()
+	{
+		++m_counter;
+		wake_waiters();
+	}
+
+	void release(std::ptrdiff_t n)
+	{
+		assert(n >= 0);
+		m_counter += n;
+		wake_waiters();
+	}
+
+	const executor_type& get_executor() const noexcept { return m_ex; }
+
+private:
+	executor_type m_ex;
+	std::ptrdiff_t m_counter;
+	detail::waiter_list<waiter> m_waiters;
+
+	template<class Handler>
+	void start_acquire(Handler&& h, std::ptrdiff_t n)
+	{
+		if (m_waiters.empty() && m_counter >= n)
+		{
+			m_counter -= n;
+			this->counters()->acquire();
+			detail::post_completion(std::forward<Handler>(h), m_ex,
+									boost::system::error_code{});
+			return;
+		}
+		waiter state;
+		state.n = n;
+		this->counters()->park();
+		m_waiters.push_back(detail::make_handler_node(std::forward<Handler>(h), m_ex, state));
+	}
+
+	void wake_waiters()
+	{
+		while (!m_waiters.empty() && m_waiters.front()->n <= m_counter)
+		{
+			auto* w = m_waiters.pop_front();
+			m_counter -= w->n;
+			this->counters()->unpark();
+			this->counters()->wakeup();
+			this->counters()->acquire();
+			w->wake();
+		}
+	}
+};
+
+} // namespace coma
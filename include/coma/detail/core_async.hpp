@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/asio/async_result.hpp>
+#include <boost/asio/execution_context.hpp>
 #include <boost/version.hpp>
 #include <coma/detail/core.hpp>
 
@@ -16,6 +17,9 @@
 							   void(boost::system::error_code, X)>::return_type
 
 #if BOOST_VERSION >= 107400
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/execution/context_as.hpp>
+#include <boost/asio/query.hpp>
 #define COMA_HAS_DEFAULT_IO_EXECUTOR
 #define COMA_SET_DEFAULT_IO_EXECUTOR = net::any_io_executor
 #else
@@ -41,4 +45,18 @@ using namespace boost::asio;
 namespace netext {
 using namespace boost::beast;
 } // namespace netext
+
+namespace detail {
+
+template<class Executor>
+net::execution_context& executor_context(const Executor& ex)
+{
+#if BOOST_VERSION >= 107400
+	return net::query(ex, net::execution::context_as_t<net::execution_context&>());
+#else
+	return ex.context();
+#endif
+}
+
+} // namespace detail
 } // namespace coma
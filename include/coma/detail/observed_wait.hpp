@@ -0,0 +1,530 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/probes.hpp>
+
+#include <boost/asio/detail/handler_tracking.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(COMA_ENABLE_TRACING)
+#include <coma/trace.hpp>
+#endif
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+#include <coma/waiter_registry.hpp>
+#endif
+
+// name of the primitive is kept for the diagnostics
+#if defined(COMA_ENABLE_TRACING) || defined(COMA_ENABLE_WAITER_REGISTRY) ||                  \
+	defined(BOOST_ASIO_ENABLE_HANDLER_TRACKING)
+#define COMA_DETAIL_HAS_TRACE_NAME
+#endif
+
+namespace coma {
+
+// Default observer policy of the primitives, all hooks are no-ops and the
+// observation compiles away, no timestamps are taken and the operations
+// store no additional state.
+//
+// A custom observer provides the same member functions. Hooks are called
+// on the executor of the primitive (or the handler, for predicate waits).
+struct null_wait_observer
+{
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	// a task starts waiting, not called for waits completing without parking
+	void on_park(time_point) noexcept {}
+	// a waiting task is resumed by a notification or release
+	void on_wake(time_point) noexcept {}
+	// a resumed task found its predicate false and waits again
+	void on_spurious_wake(time_point) noexcept {}
+	// a timed wait expired
+	void on_timeout(time_point) noexcept {}
+	// a parked task is done waiting, successfully or not
+	void on_complete(time_point /*parked*/, time_point /*now*/) noexcept {}
+};
+
+// Snapshot of the counters kept by every primitive, see stats()
+struct wait_stats
+{
+	// tasks currently waiting, and the maximum since construction
+	std::uint64_t waiters{0};
+	std::uint64_t peak_waiters{0};
+	// successful acquires (semaphores) or waits (condition variables)
+	std::uint64_t acquires{0};
+	// waiting tasks resumed by a release or notification
+	std::uint64_t wakeups{0};
+	// resumed tasks which found their predicate false and waited again
+	std::uint64_t spurious_wakeups{0};
+	std::uint64_t timeouts{0};
+	std::uint64_t cancellations{0};
+	// waits failed immediately because the queue was full
+	std::uint64_t rejections{0};
+};
+
+// Whether a primitive keeps the counters of stats(). With none, stats()
+// reports zeros and the primitive stores no counters.
+enum class wait_stats_mode
+{
+	counted,
+	none
+};
+
+namespace detail {
+
+// counters of the unsynchronized primitives
+class wait_counters
+{
+	wait_stats m_stats;
+
+public:
+	void park() noexcept
+	{
+		if (++m_stats.waiters > m_stats.peak_waiters)
+			m_stats.peak_waiters = m_stats.waiters;
+	}
+	void unpark() noexcept { --m_stats.waiters; }
+	void acquire() noexcept { ++m_stats.acquires; }
+	void wakeup() noexcept { ++m_stats.wakeups; }
+	void spurious_wakeup() noexcept { ++m_stats.spurious_wakeups; }
+	void timeout() noexcept { ++m_stats.timeouts; }
+	void cancellation() noexcept { ++m_stats.cancellations; }
+	void rejection() noexcept { ++m_stats.rejections; }
+
+	COMA_NODISCARD wait_stats snapshot() const noexcept { return m_stats; }
+};
+
+// counters of the primitives with wait_stats_mode::none
+struct null_wait_counters
+{
+	void park() noexcept {}
+	void unpark() noexcept {}
+	void acquire() noexcept {}
+	void wakeup() noexcept {}
+	void spurious_wakeup() noexcept {}
+	void timeout() noexcept {}
+	void cancellation() noexcept {}
+	void rejection() noexcept {}
+
+	COMA_NODISCARD wait_stats snapshot() const noexcept { return {}; }
+};
+
+// Provides stats() to a primitive, a base such that it takes no space
+// without counters
+template<wait_stats_mode Stats>
+class wait_stats_base
+{
+	wait_counters m_counters;
+
+public:
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
+protected:
+	using counters_type = wait_counters;
+
+	wait_counters* counters() noexcept { return &m_counters; }
+};
+
+template<>
+class wait_stats_base<wait_stats_mode::none>
+{
+public:
+	COMA_NODISCARD wait_stats stats() const noexcept { return {}; }
+
+protected:
+	using counters_type = null_wait_counters;
+
+	// stateless, shared by all primitives
+	static null_wait_counters* counters() noexcept
+	{
+		static null_wait_counters c;
+		return &c;
+	}
+};
+
+// counters of the synchronized primitives, written on their strand
+// and read from any thread
+class atomic_wait_counters
+{
+	using counter = std::atomic<std::uint64_t>;
+
+	counter m_waiters{0};
+	counter m_peak_waiters{0};
+	counter m_acquires{0};
+	counter m_wakeups{0};
+	counter m_spurious_wakeups{0};
+	counter m_timeouts{0};
+	counter m_cancellations{0};
+	counter m_rejections{0};
+
+	// single writer, no read-modify-write needed
+	static std::uint64_t add(counter& c, std::uint64_t n) noexcept
+	{
+		const auto v = c.load(std::memory_order_relaxed) + n;
+		c.store(v, std::memory_order_relaxed);
+		return v;
+	}
+
+public:
+	void park() noexcept
+	{
+		const auto w = add(m_waiters, 1);
+		if (w > m_peak_waiters.load(std::memory_order_relaxed))
+			m_peak_waiters.store(w, std::memory_order_relaxed);
+	}
+	void unpark() noexcept { add(m_waiters, ~std::uint64_t{0}); }
+	void acquire() noexcept { add(m_acquires, 1); }
+	void wakeup() noexcept { add(m_wakeups, 1); }
+	void spurious_wakeup() noexcept { add(m_spurious_wakeups, 1); }
+	void timeout() noexcept { add(m_timeouts, 1); }
+	void cancellation() noexcept { add(m_cancellations, 1); }
+	void rejection() noexcept { add(m_rejections, 1); }
+
+	COMA_NODISCARD wait_stats snapshot() const noexcept
+	{
+		wait_stats s;
+		s.waiters = m_waiters.load(std::memory_order_relaxed);
+		s.peak_waiters = m_peak_waiters.load(std::memory_order_relaxed);
+		s.acquires = m_acquires.load(std::memory_order_relaxed);
+		s.wakeups = m_wakeups.load(std::memory_order_relaxed);
+		s.spurious_wakeups = m_spurious_wakeups.load(std::memory_order_relaxed);
+		s.timeouts = m_timeouts.load(std::memory_order_relaxed);
+		s.cancellations = m_cancellations.load(std::memory_order_relaxed);
+		s.rejections = m_rejections.load(std::memory_order_relaxed);
+		return s;
+	}
+};
+
+// Diagnostics of a primitive shared by all of its waits
+class wait_monitor_base
+{
+#if defined(COMA_DETAIL_HAS_TRACE_NAME)
+	const char* m_trace_name;
+#endif
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+	registry_waiters m_registry_waiters{this};
+#endif
+
+public:
+	// name shown in traces and the waiter registry, must outlive the primitive
+	void set_trace_name(const char* name) noexcept
+	{
+#if defined(COMA_DETAIL_HAS_TRACE_NAME)
+		m_trace_name = name;
+#else
+		(void)name;
+#endif
+	}
+
+protected:
+	explicit wait_monitor_base(const char* name) noexcept
+#if defined(COMA_DETAIL_HAS_TRACE_NAME)
+		: m_trace_name{name}
+#endif
+	{
+		(void)name;
+	}
+	wait_monitor_base(const wait_monitor_base&) = delete;
+	wait_monitor_base& operator=(const wait_monitor_base&) = delete;
+
+	// permits reported by the waiter registry
+	void watch_permits(const std::ptrdiff_t* permits) noexcept
+	{
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+		m_registry_waiters.watch_permits(permits);
+#else
+		(void)permits;
+#endif
+	}
+
+	friend class observed_wait_base;
+
+	const char* trace_name() const noexcept
+	{
+#if defined(COMA_DETAIL_HAS_TRACE_NAME)
+		return m_trace_name;
+#else
+		return nullptr;
+#endif
+	}
+};
+
+// Observer of a primitive with wait_stats_mode::none, the primitives pass
+// observer_policy<Observer, Stats> to wait_monitor and the operations
+template<class Observer>
+struct uncounted_observer : Observer
+{
+};
+
+template<class Observer, wait_stats_mode Stats>
+using observer_policy = typename std::conditional<Stats == wait_stats_mode::counted, Observer,
+												  uncounted_observer<Observer>>::type;
+
+template<class Observer>
+struct stats_mode_of : std::integral_constant<wait_stats_mode, wait_stats_mode::counted>
+{
+};
+
+template<class Observer>
+struct stats_mode_of<uncounted_observer<Observer>>
+	: std::integral_constant<wait_stats_mode, wait_stats_mode::none>
+{
+};
+
+// the operations skip the counters of uncounted primitives
+inline wait_counters* op_counters(wait_counters* c) noexcept
+{
+	return c;
+}
+inline wait_counters* op_counters(null_wait_counters*) noexcept
+{
+	return nullptr;
+}
+
+// Adds the counters and the observer of a primitive, stored as bases for
+// the empty base optimization. The monitor base comes first, such that its
+// address is the one of the primitive.
+template<class Observer>
+class wait_monitor : public wait_monitor_base
+	, public wait_stats_base<stats_mode_of<Observer>::value>
+	, private Observer
+{
+public:
+	Observer& observer() noexcept { return *this; }
+	const Observer& observer() const noexcept { return *this; }
+
+protected:
+	explicit wait_monitor(const char* name) noexcept
+		: wait_monitor_base{name}
+	{
+	}
+
+	wait_monitor* monitor() noexcept { return this; }
+
+	template<class O>
+	friend class observed_wait;
+	template<class O>
+	friend class unobserved_wait;
+};
+
+// tag of a wait shown by the waiter registry, see tag_wait()
+template<class Handler>
+const char* waiter_tag_of(const Handler&) noexcept
+{
+	return nullptr;
+}
+
+// Base of the wait operations, updates the counters of the primitive if any,
+// fires the probes and records a span in tracing builds. With asio's
+// handler tracking each wait is shown as a handler of the primitive,
+// created when the task parks and invoked when it resumes. Operations call
+// observe_park() with the executor and tag of the waiter right before their
+// first wait on the timer, those which complete on their initial check never
+// park and only count as acquires.
+class observed_wait_base BOOST_ASIO_INHERIT_TRACKED_HANDLER
+{
+protected:
+	wait_monitor_base* m_monitor;
+	wait_counters* m_counters;
+	bool m_parked{false};
+#if defined(COMA_ENABLE_TRACING)
+	trace_span m_span;
+#endif
+#if defined(COMA_ENABLE_USDT)
+	std::chrono::steady_clock::time_point m_probe_begin;
+#endif
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+	registry_entry m_registry_entry;
+#endif
+
+	observed_wait_base(wait_monitor_base* m, wait_counters* c) noexcept
+		: m_monitor{m}
+		, m_counters{c}
+	{
+	}
+
+	// ex is the executor of the waiter, the one associated with its handler
+	template<class Executor>
+	void count_park(const Executor& ex, const char* tag)
+	{
+		(void)ex;
+		(void)tag;
+		m_parked = true;
+		if (m_counters)
+			m_counters->park();
+		BOOST_ASIO_HANDLER_CREATION((executor_context(ex), *this, m_monitor->trace_name(),
+									 m_monitor, 0, "wait"));
+#if defined(COMA_ENABLE_TRACING)
+		m_span.name = m_monitor->trace_name();
+		m_span.object = m_monitor;
+		m_span.context = executor_context_id(ex);
+		m_span.begin = trace_span::clock::now();
+#endif
+#if defined(COMA_ENABLE_USDT)
+		m_probe_begin = std::chrono::steady_clock::now();
+#endif
+		COMA_PROBE2(wait_start, m_monitor, m_counters ? m_counters->snapshot().waiters : 0);
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+		m_registry_entry.link(m_monitor->m_registry_waiters, m_monitor->trace_name(), tag);
+#endif
+	}
+
+	void count_wake() noexcept
+	{
+		if (m_counters)
+			m_counters->wakeup();
+	}
+	void count_spurious_wake() noexcept
+	{
+		if (m_counters)
+			m_counters->spurious_wakeup();
+	}
+	void count_timeout()
+	{
+		if (m_counters)
+			m_counters->timeout();
+		COMA_PROBE1(timeout, m_monitor);
+	}
+
+	void count_complete(boost::system::error_code ec, bool acquired)
+	{
+		if (m_counters)
+		{
+			if (m_parked)
+				m_counters->unpark();
+			if (ec)
+				m_counters->cancellation();
+			else if (acquired)
+				m_counters->acquire();
+		}
+#if defined(BOOST_ASIO_ENABLE_HANDLER_TRACKING)
+		if (m_parked)
+		{
+			BOOST_ASIO_HANDLER_COMPLETION((*this));
+			BOOST_ASIO_HANDLER_INVOCATION_BEGIN((ec));
+			BOOST_ASIO_HANDLER_INVOCATION_END;
+		}
+#endif
+#if defined(COMA_ENABLE_WAITER_REGISTRY)
+		m_registry_entry.unlink();
+#endif
+#if defined(COMA_ENABLE_TRACING)
+		if (m_parked)
+		{
+			m_span.end = trace_span::clock::now();
+			m_span.cancelled = static_cast<bool>(ec);
+			global_trace_buffer().record(m_span);
+		}
+#endif
+#if defined(COMA_ENABLE_USDT)
+		if (m_parked)
+			COMA_PROBE3(wait_end, m_monitor,
+						std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - m_probe_begin)
+							.count(),
+						static_cast<int>(static_cast<bool>(ec)));
+#endif
+	}
+};
+
+// Additionally forwards the events of one wait to the observer
+// of the primitive together with timestamps.
+template<class Observer>
+class observed_wait : observed_wait_base
+{
+	using clock = typename Observer::clock;
+	using time_point = typename Observer::time_point;
+
+	Observer* m_observer;
+	time_point m_parked_at;
+
+protected:
+	explicit observed_wait(wait_monitor<Observer>* m) noexcept
+		: observed_wait_base{m, op_counters(m->counters())}
+		, m_observer{&m->observer()}
+	{
+	}
+
+	// the wait parks on the timer, may be called again after spurious wakeups
+	template<class Executor>
+	void observe_park(const Executor& ex, const char* tag)
+	{
+		if (m_parked)
+			return;
+		count_park(ex, tag);
+		m_parked_at = clock::now();
+		m_observer->on_park(m_parked_at);
+	}
+
+	void observe_wake()
+	{
+		count_wake();
+		m_observer->on_wake(clock::now());
+	}
+	void observe_spurious_wake()
+	{
+		count_spurious_wake();
+		m_observer->on_spurious_wake(clock::now());
+	}
+	void observe_timeout()
+	{
+		count_timeout();
+		m_observer->on_timeout(clock::now());
+	}
+	// acquired is false for timeouts
+	void observe_complete(boost::system::error_code ec, bool acquired = true)
+	{
+		count_complete(ec, acquired);
+		if (m_parked)
+			m_observer->on_complete(m_parked_at, clock::now());
+	}
+};
+
+// Waits of the primitives with the default observer, no timestamps are taken
+template<class Observer>
+class unobserved_wait : observed_wait_base
+{
+protected:
+	explicit unobserved_wait(wait_monitor<Observer>* m) noexcept
+		: observed_wait_base{m, op_counters(m->counters())}
+	{
+	}
+
+	template<class Executor>
+	void observe_park(const Executor& ex, const char* tag)
+	{
+		if (!m_parked)
+			count_park(ex, tag);
+	}
+	void observe_wake() noexcept { count_wake(); }
+	void observe_spurious_wake() noexcept { count_spurious_wake(); }
+	void observe_timeout() { count_timeout(); }
+	void observe_complete(boost::system::error_code ec, bool acquired = true)
+	{
+		count_complete(ec, acquired);
+	}
+};
+
+template<>
+class observed_wait<null_wait_observer> : public unobserved_wait<null_wait_observer>
+{
+protected:
+	using unobserved_wait<null_wait_observer>::unobserved_wait;
+};
+
+template<>
+class observed_wait<uncounted_observer<null_wait_observer>>
+	: public unobserved_wait<uncounted_observer<null_wait_observer>>
+{
+protected:
+	using unobserved_wait<uncounted_observer<null_wait_observer>>::unobserved_wait;
+};
+
+} // namespace detail
+} // namespace coma
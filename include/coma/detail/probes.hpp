@@ -0,0 +1,25 @@
+#pragma once
+
+// USDT probes for bpftrace/perf/systemtap, enabled by defining
+// COMA_ENABLE_USDT (requires <sys/sdt.h>, systemtap-sdt-dev). Otherwise
+// the probes and their arguments compile to nothing. Provider is "coma":
+//
+//   wait_start(object, waiters)          a task parks, waiters includes it
+//   wait_end(object, wait_ns, cancelled) a parked task is done waiting
+//   timeout(object)                      a timed wait expired
+//   notify_one(object, waiters)
+//   notify_n(object, waiters, n)
+//   notify_all(object, waiters)          waiters is the size of the herd
+//   release(object, n, waiters)
+//
+// e.g. bpftrace -e 'usdt:./app:coma:wait_end { @ns = hist(arg1); }'
+#if defined(COMA_ENABLE_USDT)
+#include <sys/sdt.h>
+#define COMA_PROBE1(name, a) DTRACE_PROBE1(coma, name, a)
+#define COMA_PROBE2(name, a, b) DTRACE_PROBE2(coma, name, a, b)
+#define COMA_PROBE3(name, a, b, c) DTRACE_PROBE3(coma, name, a, b, c)
+#else
+#define COMA_PROBE1(name, a) ((void)0)
+#define COMA_PROBE2(name, a, b) ((void)0)
+#define COMA_PROBE3(name, a, b, c) ((void)0)
+#endif
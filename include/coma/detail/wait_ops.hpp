@@ -1,38 +1,45 @@
 #pragma once
 
 #include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
 
 #include <boost/asio/async_result.hpp>
 #include <boost/beast/core/async_base.hpp>
 
+#include <cstddef>
+#include <cstdint>
+
 namespace coma {
 
 namespace detail {
 
-template<class Handler, class Timer>
+template<class Handler, class Timer, class Observer>
 class base_wait_op : public netext::async_base<Handler, typename Timer::executor_type>
+	, protected observed_wait<Observer>
 {
 protected:
 	Timer& timer;
 
 public:
 	template<class H>
-	base_wait_op(H&& h, Timer& tp)
+	base_wait_op(H&& h, Timer& tp, wait_monitor<Observer>* o)
 		: netext::async_base<Handler, typename Timer::executor_type>(std::forward<H>(h),
 																	 tp.get_executor())
+		, observed_wait<Observer>(o)
 		, timer{tp}
 	{
 	}
 };
 
-template<class Handler, class Timer>
-class wait_op : public base_wait_op<Handler, Timer>
+template<class Handler, class Timer, class Observer>
+class wait_op : public base_wait_op<Handler, Timer, Observer>
 {
 public:
 	template<class H>
-	wait_op(H&& h, Timer& tp)
-		: base_wait_op<Handler, Timer>(std::forward<H>(h), tp)
+	wait_op(H&& h, Timer& tp, wait_monitor<Observer>* o)
+		: base_wait_op<Handler, Timer, Observer>(std::forward<H>(h), tp, o)
 	{
+		this->observe_park(this->get_executor(), waiter_tag_of(this->handler()));
 		this->timer.async_wait(std::move(*this));
 	}
 
@@ -40,28 +47,45 @@ public:
 	{
 		if (ec == net::error::operation_aborted)
 			ec = {};
+		this->observe_wake();
+		this->observe_complete(ec);
 		this->complete_now(ec);
 	}
 };
 
 struct run_wait_op
 {
-	template<class Handler, class Timer>
-	void operator()(Handler&& h, Timer* t)
+	template<class Handler, class Timer, class Observer>
+	void operator()(Handler&& h, Timer* t, wait_monitor<Observer>* o)
 	{
-		wait_op<typename std::decay<Handler>::type, Timer>(std::forward<Handler>(h), *t);
+		wait_op<typename std::decay<Handler>::type, Timer, Observer>(std::forward<Handler>(h),
+																	 *t, o);
 	}
 };
 
-template<class Handler, class Timer, class Predicate>
-class wait_pred_op : public base_wait_op<Handler, Timer>
+template<class Handler, class Timer, class Predicate, class Observer>
+class wait_pred_op : public base_wait_op<Handler, Timer, Observer>
 {
 	Predicate pred;
 
+	void check(boost::system::error_code ec, bool woken)
+	{
+		if (ec || pred())
+		{
+			this->observe_complete(ec);
+			this->complete_now(ec);
+			return;
+		}
+		if (woken)
+			this->observe_spurious_wake();
+		this->observe_park(this->get_executor(), waiter_tag_of(this->handler()));
+		this->timer.async_wait(std::move(*this));
+	}
+
 public:
 	template<class H, class P>
-	wait_pred_op(H&& h, Timer& tp, P&& p)
-		: base_wait_op<Handler, Timer>(std::forward<H>(h), tp)
+	wait_pred_op(H&& h, Timer& tp, P&& p, wait_monitor<Observer>* o)
+		: base_wait_op<Handler, Timer, Observer>(std::forward<H>(h), tp, o)
 		, pred{std::forward<P>(p)}
 	{
 		// must be posted such that there is no suspension point
@@ -69,27 +93,119 @@ public:
 		net::post(std::move(*this));
 	}
 
-	void operator()(boost::system::error_code ec = boost::system::error_code{})
+	// initial check, posted
+	void operator()() { check({}, false); }
+
+	// woken by the timer
+	void operator()(boost::system::error_code ec)
 	{
 		if (ec == net::error::operation_aborted)
 			ec = {};
-		if (ec || pred())
-			this->complete_now(ec);
-		else
-			this->timer.async_wait(std::move(*this));
+		this->observe_wake();
+		check(ec, true);
 	}
 };
 
 struct run_wait_pred_op
 {
-	template<class Handler, class Timer, class Predicate>
-	void operator()(Handler&& h, Timer* t, Predicate&& pred)
+	template<class Handler, class Timer, class Predicate, class Observer>
+	void operator()(Handler&& h, Timer* t, Predicate&& pred, wait_monitor<Observer>* o)
 	{
 		wait_pred_op<typename std::decay<Handler>::type, Timer,
-					 typename std::decay<Predicate>::type>(std::forward<Handler>(h), *t,
-														   std::forward<Predicate>(pred));
+					 typename std::decay<Predicate>::type, Observer>(
+			std::forward<Handler>(h), *t, std::forward<Predicate>(pred), o);
+	}
+};
+
+// Waits until Grant returns a number of permits other than 0 and
+// completes with it
+template<class Handler, class Timer, class Grant, class Observer>
+class wait_up_to_op : public base_wait_op<Handler, Timer, Observer>
+{
+	Grant grant;
+
+	void check(boost::system::error_code ec, bool woken)
+	{
+		if (ec)
+		{
+			this->observe_complete(ec);
+			this->complete_now(ec, std::ptrdiff_t{0});
+			return;
+		}
+		const auto granted = grant();
+		if (granted > 0)
+		{
+			this->observe_complete(ec);
+			this->complete_now(ec, granted);
+			return;
+		}
+		if (woken)
+			this->observe_spurious_wake();
+		this->observe_park(this->get_executor(), waiter_tag_of(this->handler()));
+		this->timer.async_wait(std::move(*this));
+	}
+
+public:
+	template<class H, class G>
+	wait_up_to_op(H&& h, Timer& tp, G&& g, wait_monitor<Observer>* o)
+		: base_wait_op<Handler, Timer, Observer>(std::forward<H>(h), tp, o)
+		, grant{std::forward<G>(g)}
+	{
+		// posted like wait_pred_op, no suspension point between
+		// taking the permits and calling the completion handler
+		net::post(std::move(*this));
+	}
+
+	// initial check, posted
+	void operator()() { check({}, false); }
+
+	// woken by the timer
+	void operator()(boost::system::error_code ec)
+	{
+		if (ec == net::error::operation_aborted)
+			ec = {};
+		this->observe_wake();
+		check(ec, true);
+	}
+};
+
+struct run_wait_up_to_op
+{
+	template<class Handler, class Timer, class Grant, class Observer>
+	void operator()(Handler&& h, Timer* t, Grant&& grant, wait_monitor<Observer>* o)
+	{
+		wait_up_to_op<typename std::decay<Handler>::type, Timer,
+					  typename std::decay<Grant>::type, Observer>(
+			std::forward<Handler>(h), *t, std::forward<Grant>(grant), o);
 	}
 };
 
+// Evaluates Predicate only if the generation changed since the last
+// evaluation, the first call always evaluates it
+template<class Predicate>
+struct versioned_pred
+{
+	Predicate pred;
+	const std::uint64_t* generation;
+	std::uint64_t seen;
+	bool evaluated;
+
+	bool operator()()
+	{
+		if (evaluated && *generation == seen)
+			return false;
+		seen = *generation;
+		evaluated = true;
+		return pred();
+	}
+};
+
+template<class Predicate>
+versioned_pred<typename std::decay<Predicate>::type> make_versioned_pred(
+	Predicate&& pred, const std::uint64_t* generation)
+{
+	return {std::forward<Predicate>(pred), generation, 0, false};
+}
+
 } // namespace detail
 } // namespace coma
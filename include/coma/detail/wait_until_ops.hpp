@@ -1,6 +1,7 @@
 #pragma once
 
 #include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
 
 #include <boost/asio/async_result.hpp>
 #include <boost/beast/core/async_base.hpp>
@@ -23,6 +24,7 @@ namespace detail {
 
 template<class Handler, class Impl>
 class base_wait_until_op : public netext::async_base<Handler, typename Impl::executor_type>
+	, protected observed_wait<typename Impl::observer_type>
 {
 	using time_point = typename Impl::time_point;
 protected:
@@ -84,10 +86,10 @@ public:
 	base_wait_until_op(H&& h, Impl& i, time_point et)
 		: netext::async_base<Handler, typename Impl::executor_type>(std::forward<H>(h),
 																	 i.timer.get_executor())
+		, observed_wait<typename Impl::observer_type>(&i)
 		, impl{i}
 		, endtime{et}
 	{
-		net::post(this->get_executor(), []{ puts("rass c");});
 	}
 
 };
@@ -103,11 +105,13 @@ public:
 	{
 		if (this->impl.stopped)
 		{
+			this->observe_complete(net::error::operation_aborted);
 			this->do_complete_later(std::integral_constant<bool, WithTimeout>{}, net::error::operation_aborted, cv_status::no_timeout);
 			return;
 		}
 		this->add_time_point();
 		this->impl.update_expire_time();
+		this->observe_park(this->get_executor(), waiter_tag_of(this->handler()));
 		// wait for something (timeout, signal, cancellation)
 		this->impl.timer.async_wait(std::move(*this));
 	}
@@ -120,6 +124,11 @@ public:
 			ec = net::error::operation_aborted;
 		this->endtime_guard.reset();
 		const auto status = !WithTimeout || ec || Impl::clock::now() <= this->endtime ? cv_status::no_timeout : cv_status::timeout;
+		if (status == cv_status::timeout)
+			this->observe_timeout();
+		else if (!ec)
+			this->observe_wake();
+		this->observe_complete(ec, status == cv_status::no_timeout);
 		this->do_complete_now(std::integral_constant<bool, WithTimeout>{}, ec, status);
 	}
 };
@@ -148,6 +157,7 @@ public:
 	{
 		if (this->impl.stopped)
 		{
+			this->observe_complete(net::error::operation_aborted);
 			this->do_complete_later(std::integral_constant<bool, WithTimeout>{}, net::error::operation_aborted, false);
 			return;
 		}
@@ -157,30 +167,49 @@ public:
 		net::post(std::move(*this));
 	}
 
-	void operator()(boost::system::error_code ec = boost::system::error_code{})
+	// initial check, posted
+	void operator()() { check({}, false); }
+
+	// woken by the timer
+	void operator()(boost::system::error_code ec)
 	{
 		if (ec == net::error::operation_aborted)
 			ec = {};
+		if (!ec && !this->impl.stopped)
+			this->observe_wake();
+		check(ec, true);
+	}
+
+private:
+	void check(boost::system::error_code ec, bool woken)
+	{
 		if (this->impl.stopped)
 			ec = net::error::operation_aborted;
 		if (ec)
 		{
 			this->endtime_guard.reset();
+			this->observe_complete(ec);
 			this->do_complete_now(std::integral_constant<bool, WithTimeout>{}, ec, false);
 		}
 		else if (pred())
 		{
 			this->endtime_guard.reset();
+			this->observe_complete(ec);
 			this->do_complete_now(std::integral_constant<bool, WithTimeout>{}, ec, true);
 		}
 		else if (WithTimeout && Impl::clock::now() > this->endtime)
 		{
 			this->endtime_guard.reset();
+			this->observe_timeout();
+			this->observe_complete(ec, false);
 			this->do_complete_now(std::integral_constant<bool, WithTimeout>{}, ec, false);
 		}
 		else
 		{
+			if (woken)
+				this->observe_spurious_wake();
 			this->impl.update_expire_time();
+			this->observe_park(this->get_executor(), waiter_tag_of(this->handler()));
 			// wait for something (timeout, signal, cancellation)
 			this->impl.timer.async_wait(std::move(*this));
 		}
@@ -0,0 +1,431 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+#include <coma/detail/observed_wait.hpp>
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core/async_base.hpp>
+#if BOOST_VERSION >= 107900
+#include <boost/asio/recycling_allocator.hpp>
+#else
+#include <boost/asio/detail/recycling_allocator.hpp>
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+namespace coma {
+namespace detail {
+
+// Intrusive node of a parked waiter, the handler is type erased
+// through function pointers (see handler_node) such that the owning
+// primitive does not depend on the handler types.
+struct waiter_node
+{
+	waiter_node* next{nullptr};
+	waiter_node* prev{nullptr};
+	void (*wake_fn)(waiter_node*, boost::system::error_code){nullptr};
+	void (*destroy_fn)(waiter_node*){nullptr};
+
+	// called by the primitive when the waiter is no longer in the list,
+	// completes the handler as if by post and deallocates the node
+	void wake(boost::system::error_code ec = {}) { wake_fn(this, ec); }
+
+	// deallocates the node without invoking the handler
+	void destroy() noexcept { destroy_fn(this); }
+
+	// invokes the completion handler, nodes may hide this to
+	// complete with additional arguments
+	template<class Op>
+	void invoke(Op& op, boost::system::error_code ec)
+	{
+		op.complete(false, ec);
+	}
+};
+
+// Node which the primitive asks whether it is ready before waking it,
+// see predicate_check::on_notify
+struct checked_node : waiter_node
+{
+	bool (*ready_fn)(checked_node*){nullptr};
+
+	// plain waits are always ready
+	bool ready() { return !ready_fn || ready_fn(this); }
+};
+
+// Waiter of a plain wait, counted as acquired when woken
+template<class Base = waiter_node, class Counters = wait_counters>
+struct basic_counted_waiter : Base
+{
+	Counters* counters{nullptr};
+
+	explicit basic_counted_waiter(Counters* c) noexcept
+		: counters{c}
+	{
+		counters->park();
+	}
+
+	template<class Op>
+	void invoke(Op& op, boost::system::error_code ec)
+	{
+		counters->unpark();
+		counters->wakeup();
+		if (ec)
+			counters->cancellation();
+		else
+			counters->acquire();
+		op.complete(false, ec);
+	}
+};
+
+using counted_waiter = basic_counted_waiter<>;
+
+// Intrusive FIFO list of waiters, owns the nodes. Only a head and tail
+// pointer such that an idle primitive stays small.
+template<class Node = waiter_node>
+class waiter_list
+{
+public:
+	waiter_list() = default;
+	waiter_list(const waiter_list&) = delete;
+	waiter_list& operator=(const waiter_list&) = delete;
+	~waiter_list() { clear(); }
+
+	COMA_NODISCARD bool empty() const noexcept { return m_head == nullptr; }
+
+	COMA_NODISCARD Node* front() const noexcept { return static_cast<Node*>(m_head); }
+
+	COMA_NODISCARD Node* back() const noexcept { return static_cast<Node*>(m_tail); }
+
+	static Node* next(const Node* n) noexcept { return static_cast<Node*>(n->next); }
+
+	void push_back(Node* n) noexcept
+	{
+		n->next = nullptr;
+		n->prev = m_tail;
+		if (m_tail)
+			m_tail->next = n;
+		else
+			m_head = n;
+		m_tail = n;
+	}
+
+	void push_front(Node* n) noexcept
+	{
+		n->prev = nullptr;
+		n->next = m_head;
+		if (m_head)
+			m_head->prev = n;
+		else
+			m_tail = n;
+		m_head = n;
+	}
+
+	// insert n before pos, or at the back if pos is null
+	void insert(Node* pos, Node* n) noexcept
+	{
+		if (!pos)
+		{
+			push_back(n);
+			return;
+		}
+		n->next = pos;
+		n->prev = pos->prev;
+		if (pos->prev)
+			pos->prev->next = n;
+		else
+			m_head = n;
+		pos->prev = n;
+	}
+
+	void erase(Node* n) noexcept
+	{
+		if (n->prev)
+			n->prev->next = n->next;
+		else
+			m_head = n->next;
+		if (n->next)
+			n->next->prev = n->prev;
+		else
+			m_tail = n->prev;
+		n->next = nullptr;
+		n->prev = nullptr;
+	}
+
+	Node* pop_front() noexcept
+	{
+		assert(!empty());
+		auto* n = front();
+		erase(n);
+		return n;
+	}
+
+	Node* pop_back() noexcept
+	{
+		assert(!empty());
+		auto* n = back();
+		erase(n);
+		return n;
+	}
+
+	// Wakes all waiters with operation_aborted, called by the destructors of
+	// the primitives. Like the pending waits of a destroyed timer their
+	// handlers are posted and must not use the primitive anymore.
+	void abort_all()
+	{
+		while (!empty())
+			pop_front()->wake(net::error::operation_aborted);
+	}
+
+	// destroy all waiters without invoking their handlers
+	void clear() noexcept
+	{
+		while (!empty())
+			pop_front()->destroy();
+	}
+
+private:
+	waiter_node* m_head{nullptr};
+	waiter_node* m_tail{nullptr};
+};
+
+// Nodes are allocated like asio's own operations, with the associated
+// allocator of the handler or the per-thread recycling allocator by default.
+template<class Allocator>
+struct node_allocator
+{
+	using type = Allocator;
+	static type get(const Allocator& a) { return a; }
+};
+
+// public since Boost 1.79
+template<class T>
+struct node_allocator<std::allocator<T>>
+{
+#if BOOST_VERSION >= 107900
+	using type = net::recycling_allocator<T>;
+#else
+	using type = net::detail::recycling_allocator<T>;
+#endif
+	static type get(const std::allocator<T>&) { return type{}; }
+};
+
+template<class Node, class Allocator>
+using node_allocator_t = typename std::allocator_traits<
+	typename node_allocator<Allocator>::type>::template rebind_alloc<Node>;
+
+// Allocator is the associated allocator of the handler
+template<class Node, class Allocator>
+node_allocator_t<Node, Allocator> get_node_allocator(const Allocator& a)
+{
+	return node_allocator_t<Node, Allocator>(node_allocator<Allocator>::get(a));
+}
+
+template<class Node, class Handler, class... Args>
+Node* allocate_node(const Handler& h, Args&&... args)
+{
+	auto alloc = get_node_allocator<Node>(net::get_associated_allocator(h));
+	auto* p = std::allocator_traits<decltype(alloc)>::allocate(alloc, 1);
+	try
+	{
+		return ::new (static_cast<void*>(p)) Node(std::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		std::allocator_traits<decltype(alloc)>::deallocate(alloc, p, 1);
+		throw;
+	}
+}
+
+template<class Node, class Allocator>
+void deallocate_node(Node* p, Allocator alloc) noexcept
+{
+	p->~Node();
+	std::allocator_traits<Allocator>::deallocate(alloc, p, 1);
+}
+
+// Node holding the completion handler of a parked operation and work on
+// the I/O executor, Node may carry state used by the primitive.
+template<class Node, class Handler, class Executor>
+class handler_node : public Node
+{
+	netext::async_base<Handler, Executor> m_op;
+
+	static void do_wake(waiter_node* base, boost::system::error_code ec)
+	{
+		auto* self = static_cast<handler_node*>(base);
+		auto alloc = get_node_allocator<handler_node>(self->m_op.get_allocator());
+		// handler is posted, so the node can be deallocated afterwards
+		self->invoke(self->m_op, ec);
+		deallocate_node(self, alloc);
+	}
+
+	static void do_destroy(waiter_node* base)
+	{
+		auto* self = static_cast<handler_node*>(base);
+		deallocate_node(self, get_node_allocator<handler_node>(self->m_op.get_allocator()));
+	}
+
+public:
+	template<class H>
+	handler_node(H&& h, const Executor& ex, const Node& state)
+		: Node(state)
+		, m_op(std::forward<H>(h), ex)
+	{
+		this->wake_fn = &do_wake;
+		this->destroy_fn = &do_destroy;
+	}
+};
+
+template<class Node, class Handler, class Executor>
+Node* make_handler_node(Handler&& h, const Executor& ex, const Node& state = Node{})
+{
+	using node_type = handler_node<Node, typename std::decay<Handler>::type, Executor>;
+	return allocate_node<node_type>(h, std::forward<Handler>(h), ex, state);
+}
+
+// complete handler as if by post without parking it
+template<class Handler, class Executor, class... Args>
+void post_completion(Handler&& h, const Executor& ex, Args&&... args)
+{
+	netext::async_base<typename std::decay<Handler>::type, Executor> op(
+		std::forward<Handler>(h), ex);
+	op.complete(false, std::forward<Args>(args)...);
+}
+
+// parks a node at the back of a list
+template<class Node = waiter_node>
+struct list_parker
+{
+	waiter_list<Node>* list;
+	void operator()(Node* n) const noexcept { list->push_back(n); }
+};
+
+// Node of a predicate wait, when woken the predicate is evaluated on
+// the handler's executor and the node is parked again by Parker if
+// it is false. The handler is invoked inline after pred() returns true
+// such that there is no suspension point in between.
+// With Node = checked_node the primitive evaluates the predicate through
+// ready() instead and only wakes the node once it is true, the handler
+// is then posted without evaluating it again.
+template<class Handler, class Executor, class Predicate, class Parker = list_parker<>,
+		 class Node = waiter_node, class Counters = wait_counters>
+class pred_node : public Node
+{
+	netext::async_base<Handler, Executor> m_op;
+	Predicate m_pred;
+	Parker m_parker;
+	Counters* m_counters;
+	bool m_woken{false};
+
+	struct node_deleter
+	{
+		void operator()(pred_node* n) const noexcept { n->destroy(); }
+	};
+
+	struct check
+	{
+		std::unique_ptr<pred_node, node_deleter> node;
+		void operator()() { node.release()->do_check(); }
+	};
+
+	void do_check()
+	{
+		if (m_pred())
+		{
+			complete_now({});
+			return;
+		}
+		if (m_woken)
+			m_counters->spurious_wakeup();
+		m_parker(this);
+	}
+
+	void complete_now(boost::system::error_code ec)
+	{
+		m_counters->unpark();
+		m_counters->acquire();
+		// deallocate before invoking the handler
+		auto op = std::move(m_op);
+		deallocate_node(this, get_node_allocator<pred_node>(op.get_allocator()));
+		op.complete_now(ec);
+	}
+
+	static constexpr bool checked_on_notify() { return std::is_base_of<checked_node, Node>::value; }
+
+	static bool do_ready(checked_node* base) { return static_cast<pred_node*>(base)->m_pred(); }
+
+	void init_ready(checked_node* n) noexcept { n->ready_fn = &do_ready; }
+	void init_ready(waiter_node*) noexcept {}
+
+	static void do_wake(waiter_node* base, boost::system::error_code ec)
+	{
+		auto* self = static_cast<pred_node*>(base);
+		self->m_woken = true;
+		self->m_counters->wakeup();
+		if (ec || checked_on_notify())
+		{
+			self->m_counters->unpark();
+			if (ec)
+				self->m_counters->cancellation();
+			else
+				self->m_counters->acquire();
+			auto alloc = get_node_allocator<pred_node>(self->m_op.get_allocator());
+			self->m_op.complete(false, ec);
+			deallocate_node(self, alloc);
+			return;
+		}
+		self->post_check();
+	}
+
+	static void do_destroy(waiter_node* base)
+	{
+		auto* self = static_cast<pred_node*>(base);
+		deallocate_node(self, get_node_allocator<pred_node>(self->m_op.get_allocator()));
+	}
+
+public:
+	template<class H, class P>
+	pred_node(H&& h, const Executor& ex, P&& p, Parker parker, Counters* counters)
+		: m_op(std::forward<H>(h), ex)
+		, m_pred(std::forward<P>(p))
+		, m_parker(std::move(parker))
+		, m_counters(counters)
+	{
+		m_counters->park();
+		this->wake_fn = &do_wake;
+		this->destroy_fn = &do_destroy;
+		init_ready(this);
+	}
+
+	// Node is owned by the posted function until it is parked or completed.
+	// The check runs on the executor associated with the handler, the I/O
+	// executor if there is none, not on the executor of the primitive.
+	void post_check()
+	{
+		const auto ex = net::get_associated_executor(m_op.handler(), m_op.get_executor());
+		net::post(net::bind_executor(ex, check{std::unique_ptr<pred_node, node_deleter>(this)}));
+	}
+};
+
+template<class Node = waiter_node, class Handler, class Executor, class Predicate,
+		 class Parker, class Counters>
+void start_pred_wait(Handler&& h, const Executor& ex, Predicate&& pred, Parker parker,
+					 Counters* counters)
+{
+	using node_type = pred_node<typename std::decay<Handler>::type, Executor,
+								typename std::decay<Predicate>::type, Parker, Node, Counters>;
+	auto* n = allocate_node<node_type>(h, std::forward<Handler>(h), ex,
+									   std::forward<Predicate>(pred), std::move(parker),
+									   counters);
+	// must be posted such that there is no suspension point
+	// between pred() == true and calling the completion handler
+	n->post_check();
+}
+
+} // namespace detail
+} // namespace coma
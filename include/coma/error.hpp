@@ -0,0 +1,64 @@
+#pragma once
+
+#include <boost/system/error_code.hpp>
+
+#include <string>
+#include <type_traits>
+
+namespace coma {
+
+// Errors a wait on a primitive completes with, besides
+// boost::asio::error::operation_aborted
+enum class error
+{
+	// the waiter was failed by overload control, e.g. its queueing
+	// delay exceeded the budget of an async_codel_semaphore
+	dropped = 1,
+	// the wait queue of the primitive reached its maximum length,
+	// see async_semaphore::set_max_waiters()
+	queue_full
+};
+
+namespace detail {
+
+class error_category : public boost::system::error_category
+{
+public:
+	const char* name() const noexcept override { return "coma"; }
+
+	std::string message(int ev) const override
+	{
+		switch (static_cast<error>(ev))
+		{
+		case error::dropped:
+			return "Waiter dropped by overload control";
+		case error::queue_full:
+			return "Wait queue is full";
+		}
+		return "coma error";
+	}
+};
+
+} // namespace detail
+
+inline const boost::system::error_category& error_category() noexcept
+{
+	static const detail::error_category category;
+	return category;
+}
+
+inline boost::system::error_code make_error_code(error e) noexcept
+{
+	return {static_cast<int>(e), error_category()};
+}
+
+} // namespace coma
+
+namespace boost {
+namespace system {
+template<>
+struct is_error_code_enum<coma::error> : std::true_type
+{
+};
+} // namespace system
+} // namespace boost
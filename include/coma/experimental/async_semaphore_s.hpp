@@ -1,13 +1,21 @@
 #pragma once
 
 #include <coma/detail/core_async.hpp>
-#include <coma/detail/wait_ops.hpp>
+#if defined(COMA_COROUTINES)
+
+#include <coma/detail/observed_wait.hpp>
 #include <coma/semaphore_guards.hpp>
 
-#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
 
 #include <cassert>
 #include <cinttypes>
+#include <type_traits>
 
 namespace coma {
 
@@ -18,16 +26,14 @@ template<class Executor, class F>
 COMA_NODISCARD auto co_dispatch(Executor ex, F&& f) -> net::awaitable<typename
 std::invoke_result_t<F&&>::value_type>
 {
-	//auto c = co_await net::this_coro::executor;
-	//if (ex == c)
-	if (ex == co_await net::this_coro::executor)
+	// co_await inside the comparison is miscompiled by gcc
+	const auto current = co_await net::this_coro::executor;
+	if (ex == current)
 	{
-		puts("== dispatch same");
 		co_return co_await std::forward<F>(f)();
 	}
 	else
 	{
-		puts("== dispatch spawn");
 		co_return co_await net::co_spawn(ex, std::forward<F>(f), net::use_awaitable);
 	}
 }
@@ -46,26 +52,35 @@ public:
 		, m_counter{init}
 	{
 		assert(0 <= m_counter);
-				std::cout << "ctor address = " << static_cast<void*>(this) << std::endl;
 	}
 
 	const executor_type& get_executor() const { return m_strand; }
 
+	// may be called from any thread
+	COMA_NODISCARD wait_stats stats() const noexcept { return m_counters.snapshot(); }
+
 	COMA_NODISCARD net::awaitable<void> async_acquire()
 	{
-				puts("== timer dispatching");
 		co_await co_dispatch(m_strand, [this]() -> net::awaitable<void> {
-				puts("== timer async wait");
-				std::cout << "caq address = " << static_cast<void*>(this) << std::endl;
 			assert(m_counter >= 0);
+			// another task on the strand may take the permit between
+			// cancel_one() and this task resuming, so check again
 			if (m_counter == 0)
 			{
-				boost::system::error_code ec;
-				co_await m_timer.async_wait(net::redirect_error(net::use_awaitable, ec));
-				assert(m_counter > 0);
-				puts("== timer async wait done");
+				m_counters.park();
+				while (true)
+				{
+					boost::system::error_code ec;
+					co_await m_timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+					m_counters.wakeup();
+					if (m_counter != 0)
+						break;
+					m_counters.spurious_wakeup();
+				}
+				m_counters.unpark();
 			}
 			--m_counter;
+			m_counters.acquire();
 		});
 	}
 
@@ -78,6 +93,7 @@ public:
 				co_return false;
 			}
 			--m_counter;
+			m_counters.acquire();
 			co_return true;
 		});
 	}
@@ -88,8 +104,6 @@ public:
 	COMA_NODISCARD net::awaitable<void> async_release()
 	{
 		co_await co_dispatch(m_strand, [this]() -> net::awaitable<void> {
-				puts("== timer cancel");
-				std::cout << "release address = " << static_cast<void*>(this) << std::endl;
 			++m_counter;
 			m_timer.cancel_one();
 			co_return;
@@ -113,6 +127,9 @@ private:
 	net::steady_timer m_timer;
 	net::strand<timer_executor_type> m_strand;
 	std::ptrdiff_t m_counter;
+	detail::atomic_wait_counters m_counters;
 };
 
 } // namespace coma
+
+#endif
@@ -2,7 +2,9 @@
 
 #include <coma/detail/core.hpp>
 
+#include <array>
 #include <cassert>
+#include <cstddef>
 #include <chrono>
 #include <system_error>
 #include <utility>
@@ -230,4 +232,74 @@ void swap(unique_acquire_guard<Sem>& a, unique_acquire_guard<Sem>& b) noexcept
 	a.swap(b);
 }
 
+// Call release(n) on N semaphores at scope exit if owns acquire,
+// see async_acquire_all()
+template<class Semaphore, std::size_t N>
+class acquire_all_guard
+{
+public:
+	using semaphore_type = Semaphore;
+	using permits_type = std::array<std::pair<Semaphore*, std::ptrdiff_t>, N>;
+
+	acquire_all_guard() noexcept = default;
+
+	COMA_NODISCARD acquire_all_guard(const permits_type& permits, adapt_acquire_t) noexcept
+		: m_permits(permits)
+		, m_active{true}
+	{
+	}
+
+	acquire_all_guard(const acquire_all_guard&) = delete;
+
+	COMA_NODISCARD acquire_all_guard(acquire_all_guard&& o) noexcept
+		: m_permits(o.m_permits)
+		, m_active{detail::exchange(o.m_active, false)}
+	{
+	}
+
+	~acquire_all_guard()
+	{
+		if (m_active)
+			do_release();
+	}
+
+	acquire_all_guard& operator=(const acquire_all_guard&) = delete;
+
+	acquire_all_guard& operator=(acquire_all_guard&& o) noexcept
+	{
+		if (m_active)
+			do_release();
+		m_permits = o.m_permits;
+		m_active = detail::exchange(o.m_active, false);
+		return *this;
+	}
+
+	void release()
+	{
+		if (!m_active)
+			throw std::system_error(
+				std::make_error_code(std::errc::operation_not_permitted),
+				"acquire_all_guard::release(): does not own acquire");
+		m_active = false;
+		do_release();
+	}
+
+	// the semaphores and permits, empty if default constructed
+	COMA_NODISCARD const permits_type& permits() const noexcept { return m_permits; }
+
+	COMA_NODISCARD bool owns_acquire() const noexcept { return m_active; }
+
+	explicit operator bool() const noexcept { return owns_acquire(); }
+
+private:
+	permits_type m_permits{};
+	bool m_active{false};
+
+	void do_release()
+	{
+		for (auto& p : m_permits)
+			p.first->release(p.second);
+	}
+};
+
 } // namespace coma
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+
+#include <boost/asio/execution_context.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#if !defined(COMA_TRACE_BUFFER_SIZE)
+#define COMA_TRACE_BUFFER_SIZE 65536
+#endif
+
+namespace coma {
+
+// One wait on a primitive, from park to resume. Only recorded in tracing
+// builds (COMA_ENABLE_TRACING defined).
+struct trace_span
+{
+	using clock = std::chrono::steady_clock;
+
+	// name of the primitive, see set_trace_name()
+	const char* name;
+	// address of the primitive
+	const void* object;
+	// address of the execution context of the waiter's executor
+	std::uintptr_t context;
+	clock::time_point begin;
+	clock::time_point end;
+	bool cancelled;
+};
+
+// Thread-safe ring buffer of the most recent spans
+class trace_buffer
+{
+public:
+	explicit trace_buffer(std::size_t capacity = COMA_TRACE_BUFFER_SIZE)
+		: m_capacity{capacity == 0 ? 1 : capacity}
+	{
+	}
+	trace_buffer(const trace_buffer&) = delete;
+	trace_buffer& operator=(const trace_buffer&) = delete;
+
+	void record(const trace_span& s)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (m_spans.size() < m_capacity)
+			m_spans.push_back(s);
+		else
+			m_spans[m_next] = s;
+		m_next = (m_next + 1) % m_capacity;
+		++m_total;
+	}
+
+	// oldest first
+	COMA_NODISCARD std::vector<trace_span> spans() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (m_spans.size() < m_capacity)
+			return m_spans;
+		std::vector<trace_span> r;
+		r.reserve(m_spans.size());
+		r.insert(r.end(), m_spans.begin() + static_cast<std::ptrdiff_t>(m_next), m_spans.end());
+		r.insert(r.end(), m_spans.begin(), m_spans.begin() + static_cast<std::ptrdiff_t>(m_next));
+		return r;
+	}
+
+	// spans recorded since construction or clear(), including overwritten ones
+	COMA_NODISCARD std::uint64_t total() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_total;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_spans.clear();
+		m_next = 0;
+		m_total = 0;
+	}
+
+	// Chrome trace-event JSON (chrome://tracing, Perfetto), one complete
+	// event per span with one track per execution context
+	void write_chrome_trace(std::ostream& os) const
+	{
+		const auto all = spans();
+		std::set<std::uintptr_t> contexts;
+		os << "{\"traceEvents\":[";
+		const char* sep = "\n";
+		for (const auto& s : all)
+		{
+			contexts.insert(s.context);
+			os << sep << "{\"name\":";
+			write_json_string(os, s.name ? s.name : "coma");
+			os << ",\"cat\":\"coma\""
+			   << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << s.context << ",\"ts\":" << micros(s.begin)
+			   << ",\"dur\":" << micros(s.end) - micros(s.begin) << ",\"args\":{\"object\":\""
+			   << s.object << "\",\"cancelled\":" << (s.cancelled ? "true" : "false") << "}}";
+			sep = ",\n";
+		}
+		for (auto c : contexts)
+		{
+			os << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << c
+			   << ",\"args\":{\"name\":\"executor context 0x" << std::hex << c << std::dec
+			   << "\"}}";
+			sep = ",\n";
+		}
+		os << "\n]}\n";
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::vector<trace_span> m_spans;
+	std::size_t m_capacity;
+	std::size_t m_next{0};
+	std::uint64_t m_total{0};
+
+	// names are set by the user
+	static void write_json_string(std::ostream& os, const char* str)
+	{
+		static const char hex[] = "0123456789abcdef";
+		os << '"';
+		for (; *str; ++str)
+		{
+			const auto c = static_cast<unsigned char>(*str);
+			if (c == '"' || c == '\\')
+				os << '\\' << *str;
+			else if (c < 0x20)
+				os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+			else
+				os << *str;
+		}
+		os << '"';
+	}
+
+	static long long micros(trace_span::clock::time_point t)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch())
+			.count();
+	}
+};
+
+// buffer the primitives record to
+inline trace_buffer& global_trace_buffer()
+{
+	static trace_buffer buffer;
+	return buffer;
+}
+
+namespace detail {
+
+template<class Executor>
+std::uintptr_t executor_context_id(const Executor& ex)
+{
+	return reinterpret_cast<std::uintptr_t>(&executor_context(ex));
+}
+
+} // namespace detail
+} // namespace coma
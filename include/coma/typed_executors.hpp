@@ -0,0 +1,50 @@
+#pragma once
+
+#include <coma/async_codel_semaphore.hpp>
+#include <coma/async_cond_var.hpp>
+#include <coma/async_cond_var_compact.hpp>
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_edf_semaphore.hpp>
+#include <coma/async_priority_semaphore.hpp>
+#include <coma/async_rate_limiter.hpp>
+#include <coma/async_semaphore.hpp>
+#include <coma/async_semaphore_compact.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+
+namespace coma {
+
+// Aliases of the primitives using concrete executor types instead of the
+// type-erased default, which avoids indirect calls (and possibly
+// allocations) when the operations copy the executor and track work.
+
+// for tasks running directly on an io_context
+namespace io {
+using executor_type = net::io_context::executor_type;
+using async_semaphore = coma::async_semaphore<executor_type>;
+using async_semaphore_compact = coma::async_semaphore_compact<executor_type>;
+using async_priority_semaphore = coma::async_priority_semaphore<executor_type>;
+using async_codel_semaphore = coma::async_codel_semaphore<executor_type>;
+using async_edf_semaphore = coma::async_edf_semaphore<executor_type>;
+using async_rate_limiter = coma::async_rate_limiter<executor_type>;
+using async_cond_var = coma::async_cond_var<executor_type>;
+using async_cond_var_compact = coma::async_cond_var_compact<executor_type>;
+using async_cond_var_timed = coma::async_cond_var_timed<executor_type>;
+} // namespace io
+
+// for tasks running on a strand of an io_context
+namespace io_strand {
+using executor_type = net::strand<net::io_context::executor_type>;
+using async_semaphore = coma::async_semaphore<executor_type>;
+using async_semaphore_compact = coma::async_semaphore_compact<executor_type>;
+using async_priority_semaphore = coma::async_priority_semaphore<executor_type>;
+using async_codel_semaphore = coma::async_codel_semaphore<executor_type>;
+using async_edf_semaphore = coma::async_edf_semaphore<executor_type>;
+using async_rate_limiter = coma::async_rate_limiter<executor_type>;
+using async_cond_var = coma::async_cond_var<executor_type>;
+using async_cond_var_compact = coma::async_cond_var_compact<executor_type>;
+using async_cond_var_timed = coma::async_cond_var_timed<executor_type>;
+} // namespace io_strand
+
+} // namespace coma
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <coma/detail/observed_wait.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coma {
+
+// Log-linear histogram of non-negative integer values (HDR style). Each power
+// of two range is split into 2^sub_bits linear buckets, the value reported for
+// a bucket is within 2^-sub_bits of every value recorded into it.
+class latency_histogram
+{
+public:
+	static constexpr unsigned sub_bits = 5;
+	static constexpr std::size_t sub_count = std::size_t{1} << sub_bits;
+	static constexpr std::size_t bucket_count = (64 - sub_bits + 1) * sub_count;
+
+	latency_histogram()
+		: m_buckets(std::size_t{bucket_count})
+	{
+	}
+
+	void record(std::uint64_t v) noexcept
+	{
+		++m_buckets[index(v)];
+		if (m_count == 0 || v < m_min)
+			m_min = v;
+		if (v > m_max)
+			m_max = v;
+		++m_count;
+		m_sum += static_cast<double>(v);
+	}
+
+	void reset() noexcept
+	{
+		std::fill(m_buckets.begin(), m_buckets.end(), std::uint64_t{0});
+		m_count = 0;
+		m_min = 0;
+		m_max = 0;
+		m_sum = 0;
+	}
+
+	COMA_NODISCARD std::uint64_t count() const noexcept { return m_count; }
+	COMA_NODISCARD std::uint64_t min() const noexcept { return m_min; }
+	COMA_NODISCARD std::uint64_t max() const noexcept { return m_max; }
+	COMA_NODISCARD double mean() const noexcept
+	{
+		return m_count == 0 ? 0 : m_sum / static_cast<double>(m_count);
+	}
+
+	// highest value equivalent to the value at percentile p (0-100),
+	// 0 if empty
+	COMA_NODISCARD std::uint64_t percentile(double p) const noexcept
+	{
+		if (m_count == 0)
+			return 0;
+		auto rank = static_cast<std::uint64_t>(p / 100 * static_cast<double>(m_count) + 0.5);
+		if (rank < 1)
+			rank = 1;
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucket_count; ++i)
+		{
+			seen += m_buckets[i];
+			if (seen >= rank)
+				return upper_bound(i) < m_max ? upper_bound(i) : m_max;
+		}
+		return m_max;
+	}
+
+	// adds the values recorded in other
+	void merge(const latency_histogram& other) noexcept
+	{
+		if (other.m_count == 0)
+			return;
+		for (std::size_t i = 0; i < bucket_count; ++i)
+			m_buckets[i] += other.m_buckets[i];
+		if (m_count == 0 || other.m_min < m_min)
+			m_min = other.m_min;
+		if (other.m_max > m_max)
+			m_max = other.m_max;
+		m_count += other.m_count;
+		m_sum += other.m_sum;
+	}
+
+private:
+	std::vector<std::uint64_t> m_buckets;
+	std::uint64_t m_count{0};
+	std::uint64_t m_min{0};
+	std::uint64_t m_max{0};
+	double m_sum{0};
+
+	static unsigned msb(std::uint64_t v) noexcept
+	{
+#if defined(__GNUC__)
+		return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+		unsigned r = 0;
+		while (v >>= 1)
+			++r;
+		return r;
+#endif
+	}
+
+	static std::size_t index(std::uint64_t v) noexcept
+	{
+		if (v < sub_count)
+			return static_cast<std::size_t>(v);
+		const unsigned shift = msb(v) - sub_bits;
+		return (shift + 1) * sub_count + static_cast<std::size_t>((v >> shift) - sub_count);
+	}
+
+	static std::uint64_t upper_bound(std::size_t i) noexcept
+	{
+		if (i < sub_count)
+			return i;
+		const auto shift = static_cast<unsigned>(i / sub_count - 1);
+		const std::uint64_t top = sub_count + i % sub_count;
+		return ((top + 1) << shift) - 1;
+	}
+};
+
+// Observer recording wait latency (park to completion, in nanoseconds) and the
+// queue depth seen by each parking task into histograms, and counting wakeups.
+// Not thread-safe, like the primitives it is used with.
+class histogram_wait_observer
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	void on_park(time_point) noexcept
+	{
+		++m_depth;
+		m_queue_depth.record(m_depth);
+	}
+	void on_wake(time_point) noexcept { ++m_wakeups; }
+	void on_spurious_wake(time_point) noexcept { ++m_spurious_wakeups; }
+	void on_timeout(time_point) noexcept { ++m_timeouts; }
+	void on_complete(time_point parked, time_point now) noexcept
+	{
+		--m_depth;
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - parked).count();
+		m_wait_latency.record(ns < 0 ? 0 : static_cast<std::uint64_t>(ns));
+	}
+
+	COMA_NODISCARD const latency_histogram& wait_latency() const noexcept
+	{
+		return m_wait_latency;
+	}
+	COMA_NODISCARD const latency_histogram& queue_depth() const noexcept
+	{
+		return m_queue_depth;
+	}
+	// number of tasks currently waiting
+	COMA_NODISCARD std::uint64_t depth() const noexcept { return m_depth; }
+	COMA_NODISCARD std::uint64_t wakeups() const noexcept { return m_wakeups; }
+	COMA_NODISCARD std::uint64_t spurious_wakeups() const noexcept
+	{
+		return m_spurious_wakeups;
+	}
+	COMA_NODISCARD std::uint64_t timeouts() const noexcept { return m_timeouts; }
+
+	void reset() noexcept
+	{
+		m_wait_latency.reset();
+		m_queue_depth.reset();
+		m_wakeups = 0;
+		m_spurious_wakeups = 0;
+		m_timeouts = 0;
+	}
+
+private:
+	latency_histogram m_wait_latency;
+	latency_histogram m_queue_depth;
+	std::uint64_t m_depth{0};
+	std::uint64_t m_wakeups{0};
+	std::uint64_t m_spurious_wakeups{0};
+	std::uint64_t m_timeouts{0};
+};
+
+} // namespace coma
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <coma/detail/core_async.hpp>
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#if BOOST_VERSION >= 107700
+#include <boost/asio/associated_cancellation_slot.hpp>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace coma {
+
+class waiter_registry;
+
+// Completion token tagging a wait in the waiter registry. The tag travels
+// with the handler of the wait, not with the thread starting it, so it is
+// the one of the task across suspensions and threads. The string must
+// outlive the wait.
+//
+//     co_await sem.async_acquire(coma::tag_wait("db pool", use_awaitable));
+template<class CompletionToken>
+struct tagged_wait_t
+{
+	const char* tag;
+	CompletionToken token;
+};
+
+template<class CompletionToken>
+tagged_wait_t<typename std::decay<CompletionToken>::type> tag_wait(const char* tag,
+																	CompletionToken&& token)
+{
+	return {tag, std::forward<CompletionToken>(token)};
+}
+
+namespace detail {
+
+template<class Handler>
+struct tagged_handler
+{
+	const char* tag;
+	Handler handler;
+
+	template<class... Args>
+	void operator()(Args&&... args)
+	{
+		std::move(handler)(std::forward<Args>(args)...);
+	}
+};
+
+template<class Handler>
+const char* waiter_tag_of(const tagged_handler<Handler>& h) noexcept
+{
+	return h.tag;
+}
+
+} // namespace detail
+
+// A parked waiter as seen by the registry
+struct waiter_info
+{
+	using clock = std::chrono::steady_clock;
+
+	const void* primitive;
+	// name of the primitive, see set_trace_name()
+	const char* name;
+	const char* tag;
+	clock::time_point parked;
+	// 0 is the first waiter of the primitive
+	std::size_t position;
+	// permits of a semaphore, -1 for condition variables
+	std::ptrdiff_t permits;
+};
+
+namespace detail {
+
+class registry_entry;
+
+// Parked waits of one primitive in park order, linked into the global
+// registry for the lifetime of the primitive. Only the mutex of the list is
+// taken when a wait parks or resumes, and only for linking its entry.
+class registry_waiters
+{
+	friend class registry_entry;
+	friend class coma::waiter_registry;
+
+	mutable std::mutex m_mutex;
+	registry_entry* m_head{nullptr};
+	registry_entry* m_tail{nullptr};
+	// the primitives of the global registry
+	registry_waiters* m_prev{nullptr};
+	registry_waiters* m_next{nullptr};
+	const void* m_primitive;
+	const std::ptrdiff_t* m_permits{nullptr};
+
+public:
+	explicit registry_waiters(const void* primitive);
+	// waiters of a destroyed primitive are never completed
+	~registry_waiters();
+	registry_waiters(const registry_waiters&) = delete;
+	registry_waiters& operator=(const registry_waiters&) = delete;
+
+	// permits reported for the waiters, not synchronized
+	void watch_permits(const std::ptrdiff_t* permits) noexcept { m_permits = permits; }
+};
+
+// Entry of a wait operation, linked while the wait is parked. The operation
+// is moved while parked and the entry takes the place of the moved-from one.
+class registry_entry
+{
+	friend class registry_waiters;
+	friend class coma::waiter_registry;
+
+	registry_waiters* m_list{nullptr};
+	registry_entry* m_prev{nullptr};
+	registry_entry* m_next{nullptr};
+	const char* m_name{nullptr};
+	const char* m_tag{nullptr};
+	waiter_info::clock::time_point m_parked{};
+
+public:
+	registry_entry() = default;
+	registry_entry(registry_entry&& o) noexcept
+		: m_name{o.m_name}
+		, m_tag{o.m_tag}
+		, m_parked{o.m_parked}
+	{
+		if (!o.m_list)
+			return;
+		std::lock_guard<std::mutex> lock{o.m_list->m_mutex};
+		m_list = detail::exchange(o.m_list, nullptr);
+		m_prev = detail::exchange(o.m_prev, nullptr);
+		m_next = detail::exchange(o.m_next, nullptr);
+		(m_prev ? m_prev->m_next : m_list->m_head) = this;
+		(m_next ? m_next->m_prev : m_list->m_tail) = this;
+	}
+	registry_entry& operator=(const registry_entry&) = delete;
+	~registry_entry() { unlink(); }
+
+	void link(registry_waiters& list, const char* name, const char* tag)
+	{
+		m_name = name;
+		m_tag = tag;
+		m_parked = waiter_info::clock::now();
+		std::lock_guard<std::mutex> lock{list.m_mutex};
+		m_list = &list;
+		m_prev = list.m_tail;
+		(m_prev ? m_prev->m_next : list.m_head) = this;
+		list.m_tail = this;
+	}
+
+	void unlink() noexcept
+	{
+		if (!m_list)
+			return;
+		std::lock_guard<std::mutex> lock{m_list->m_mutex};
+		(m_prev ? m_prev->m_next : m_list->m_head) = m_next;
+		(m_next ? m_next->m_prev : m_list->m_tail) = m_prev;
+		m_list = nullptr;
+		m_prev = m_next = nullptr;
+	}
+};
+
+} // namespace detail
+
+// Registry of all parked waiters of async_semaphore, async_cond_var and
+// async_cond_var_timed, only populated with COMA_ENABLE_WAITER_REGISTRY
+// defined. Each primitive keeps the list of its parked waits, the registry
+// only links the primitives. Thread-safe, except that the permit counts are
+// read without synchronization, a watchdog should run on the executor of
+// the semaphores for exact counts.
+class waiter_registry
+{
+	friend class detail::registry_waiters;
+
+public:
+	static waiter_registry& global()
+	{
+		static waiter_registry registry;
+		return registry;
+	}
+
+	// all waiters ordered by primitive and queue position
+	COMA_NODISCARD std::vector<waiter_info> waiters() const
+	{
+		return collect(waiter_info::clock::duration::min());
+	}
+
+	// waiters parked for longer than threshold
+	COMA_NODISCARD std::vector<waiter_info> stalled(waiter_info::clock::duration threshold) const
+	{
+		return collect(threshold);
+	}
+
+	void dump(std::ostream& os) const { write(os, waiters()); }
+
+	static void write(std::ostream& os, const std::vector<waiter_info>& ws)
+	{
+		const auto now = waiter_info::clock::now();
+		for (const auto& w : ws)
+		{
+			os << (w.name ? w.name : "primitive") << ' ' << w.primitive << " waiter #"
+			   << w.position << " tag=" << (w.tag ? w.tag : "-") << " parked="
+			   << std::chrono::duration_cast<std::chrono::milliseconds>(now - w.parked).count()
+			   << "ms";
+			if (w.permits >= 0)
+				os << " permits=" << w.permits;
+			os << '\n';
+		}
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	detail::registry_waiters* m_head{nullptr};
+
+	std::vector<waiter_info> collect(waiter_info::clock::duration threshold) const
+	{
+		const auto now = waiter_info::clock::now();
+		std::vector<waiter_info> r;
+		std::lock_guard<std::mutex> lock{m_mutex};
+		for (auto* list = m_head; list; list = list->m_next)
+		{
+			std::lock_guard<std::mutex> list_lock{list->m_mutex};
+			std::size_t position = 0;
+			for (auto* e = list->m_head; e; e = e->m_next, ++position)
+			{
+				if (now - e->m_parked <= threshold)
+					continue;
+				r.push_back(waiter_info{list->m_primitive, e->m_name, e->m_tag, e->m_parked,
+										position, list->m_permits ? *list->m_permits : -1});
+			}
+		}
+		std::stable_sort(r.begin(), r.end(), [](const waiter_info& a, const waiter_info& b) {
+			return std::less<const void*>{}(a.primitive, b.primitive);
+		});
+		return r;
+	}
+};
+
+namespace detail {
+
+inline registry_waiters::registry_waiters(const void* primitive)
+	: m_primitive{primitive}
+{
+	auto& registry = waiter_registry::global();
+	std::lock_guard<std::mutex> lock{registry.m_mutex};
+	m_next = registry.m_head;
+	if (m_next)
+		m_next->m_prev = this;
+	registry.m_head = this;
+}
+
+inline registry_waiters::~registry_waiters()
+{
+	auto& registry = waiter_registry::global();
+	std::lock_guard<std::mutex> lock{registry.m_mutex};
+	(m_prev ? m_prev->m_next : registry.m_head) = m_next;
+	if (m_next)
+		m_next->m_prev = m_prev;
+	std::lock_guard<std::mutex> list_lock{m_mutex};
+	for (auto* e = m_head; e;)
+	{
+		auto* next = e->m_next;
+		e->m_list = nullptr;
+		e->m_prev = e->m_next = nullptr;
+		e = next;
+	}
+}
+
+} // namespace detail
+
+// Periodically reports waiters of the global registry parked for longer
+// than a threshold, to std::cerr by default.
+template<class Executor COMA_SET_DEFAULT_IO_EXECUTOR>
+class stall_watchdog
+{
+	using clock = waiter_info::clock;
+	using timer_type = net::basic_waitable_timer<clock, net::wait_traits<clock>, Executor>;
+
+public:
+	using executor_type = Executor;
+	using report_fn = std::function<void(const std::vector<waiter_info>&)>;
+
+	stall_watchdog(const executor_type& ex, clock::duration threshold, clock::duration interval,
+				   report_fn report = &default_report)
+		: m_state{std::make_shared<state>(ex, threshold, interval, std::move(report))}
+	{
+	}
+	~stall_watchdog() { stop(); }
+	stall_watchdog(const stall_watchdog&) = delete;
+	stall_watchdog& operator=(const stall_watchdog&) = delete;
+
+	void start()
+	{
+		if (!m_state->stopped)
+			return;
+		m_state->stopped = false;
+		schedule(m_state);
+	}
+
+	void stop()
+	{
+		m_state->stopped = true;
+		m_state->timer.cancel();
+	}
+
+	static void default_report(const std::vector<waiter_info>& ws)
+	{
+		std::cerr << "coma: " << ws.size() << " stalled waiter(s)\n";
+		waiter_registry::write(std::cerr, ws);
+	}
+
+private:
+	struct state
+	{
+		timer_type timer;
+		clock::duration threshold;
+		clock::duration interval;
+		report_fn report;
+		bool stopped{true};
+
+		state(const executor_type& ex, clock::duration t, clock::duration i, report_fn r)
+			: timer{ex}
+			, threshold{t}
+			, interval{i}
+			, report{std::move(r)}
+		{
+		}
+	};
+
+	// the pending wait keeps the state alive
+	struct on_tick
+	{
+		std::shared_ptr<state> s;
+		void operator()(boost::system::error_code ec) const
+		{
+			if (ec || s->stopped)
+				return;
+			const auto ws = waiter_registry::global().stalled(s->threshold);
+			if (!ws.empty())
+				s->report(ws);
+			schedule(s);
+		}
+	};
+
+	static void schedule(const std::shared_ptr<state>& s)
+	{
+		s->timer.expires_after(s->interval);
+		s->timer.async_wait(on_tick{s});
+	}
+
+	std::shared_ptr<state> m_state;
+};
+
+} // namespace coma
+
+namespace boost {
+namespace asio {
+
+template<class CompletionToken, class Signature>
+class async_result<coma::tagged_wait_t<CompletionToken>, Signature>
+{
+	template<class Initiation>
+	struct init_wrapper
+	{
+		Initiation initiation;
+		const char* tag;
+
+		template<class Handler, class... Args>
+		void operator()(Handler&& h, Args&&... args)
+		{
+			using tagged = coma::detail::tagged_handler<typename std::decay<Handler>::type>;
+			std::move(initiation)(tagged{tag, std::forward<Handler>(h)},
+								  std::forward<Args>(args)...);
+		}
+	};
+
+public:
+	using return_type = typename async_result<CompletionToken, Signature>::return_type;
+
+	template<class Initiation, class RawToken, class... Args>
+	static return_type initiate(Initiation&& init, RawToken&& token, Args&&... args)
+	{
+		return async_initiate<CompletionToken&, Signature>(
+			init_wrapper<typename std::decay<Initiation>::type>{std::forward<Initiation>(init),
+																 token.tag},
+			token.token, std::forward<Args>(args)...);
+	}
+};
+
+template<class Handler, class Executor>
+struct associated_executor<coma::detail::tagged_handler<Handler>, Executor>
+{
+	using type = typename associated_executor<Handler, Executor>::type;
+
+	static type get(const coma::detail::tagged_handler<Handler>& h,
+					const Executor& ex = Executor()) noexcept
+	{
+		return associated_executor<Handler, Executor>::get(h.handler, ex);
+	}
+};
+
+template<class Handler, class Allocator>
+struct associated_allocator<coma::detail::tagged_handler<Handler>, Allocator>
+{
+	using type = typename associated_allocator<Handler, Allocator>::type;
+
+	static type get(const coma::detail::tagged_handler<Handler>& h,
+					const Allocator& a = Allocator()) noexcept
+	{
+		return associated_allocator<Handler, Allocator>::get(h.handler, a);
+	}
+};
+
+#if BOOST_VERSION >= 107700
+template<class Handler, class CancellationSlot>
+struct associated_cancellation_slot<coma::detail::tagged_handler<Handler>, CancellationSlot>
+{
+	using type = typename associated_cancellation_slot<Handler, CancellationSlot>::type;
+
+	static type get(const coma::detail::tagged_handler<Handler>& h,
+					const CancellationSlot& s = CancellationSlot()) noexcept
+	{
+		return associated_cancellation_slot<Handler, CancellationSlot>::get(h.handler, s);
+	}
+};
+#endif
+
+} // namespace asio
+} // namespace boost
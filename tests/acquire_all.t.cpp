@@ -0,0 +1,199 @@
+#include <coma/acquire_all.hpp>
+#include <coma/async_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <memory>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_semaphore<>;
+#else
+using async_semaphore = coma::async_semaphore<boost::asio::io_context::executor_type>;
+#endif
+
+template<std::size_t N>
+using guard_type = coma::acquire_all_guard<async_semaphore, N>;
+
+static_assert(!std::is_copy_constructible<guard_type<2>>::value, "");
+static_assert(std::is_nothrow_move_constructible<guard_type<2>>::value, "");
+static_assert(!std::is_copy_assignable<guard_type<2>>::value, "");
+static_assert(std::is_nothrow_move_assignable<guard_type<2>>::value, "");
+
+TEST_CASE("acquire_all_guard", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore a{ctx.get_executor(), 2};
+	async_semaphore b{ctx.get_executor(), 3};
+	REQUIRE(a.try_acquire_n(1));
+	REQUIRE(b.try_acquire_n(3));
+	{
+		guard_type<2> g{{{{&a, 1}, {&b, 3}}}, coma::adapt_acquire};
+		CHECK(g.owns_acquire());
+		guard_type<2> moved{std::move(g)};
+		CHECK(!g);
+		CHECK(moved);
+	}
+	CHECK(a.available() == 2);
+	CHECK(b.available() == 3);
+
+	guard_type<2> empty;
+	CHECK(!empty);
+	CHECK_THROWS_AS(empty.release(), std::system_error);
+}
+
+TEST_CASE("async_acquire_all available", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore a{ctx.get_executor(), 2};
+	async_semaphore b{ctx.get_executor(), 4};
+	async_semaphore c{ctx.get_executor(), 1};
+
+	guard_type<3> guard;
+	coma::async_acquire_all(a, 1, b, 4, c, 1,
+							[&](boost::system::error_code ec, guard_type<3> g) {
+								CHECK(!ec);
+								guard = std::move(g);
+							});
+	// taken synchronously, completed through the executor
+	CHECK(a.available() == 1);
+	CHECK(b.available() == 0);
+	CHECK(c.available() == 0);
+	CHECK(!guard);
+	ctx.poll();
+	REQUIRE(guard);
+	guard.release();
+	CHECK(a.available() == 2);
+	CHECK(b.available() == 4);
+	CHECK(c.available() == 1);
+}
+
+TEST_CASE("async_acquire_all holds nothing while waiting", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore pool{ctx.get_executor(), 1};
+	async_semaphore cpu{ctx.get_executor(), 4};
+	REQUIRE(cpu.try_acquire_n(2));
+
+	bool done = false;
+	guard_type<2> guard;
+	coma::async_acquire_all(pool, 1, cpu, 4, [&](boost::system::error_code ec, guard_type<2> g) {
+		CHECK(!ec);
+		guard = std::move(g);
+		done = true;
+	});
+	ctx.poll();
+	CHECK(!done);
+	// the pool slot is not held while waiting for cpu
+	CHECK(pool.available() == 1);
+	REQUIRE(pool.try_acquire());
+
+	// cpu available, but pool is not, the wait moves to pool
+	cpu.release(2);
+	ctx.poll();
+	CHECK(!done);
+	CHECK(cpu.available() == 4);
+
+	pool.release();
+	ctx.poll();
+	REQUIRE(done);
+	CHECK(pool.available() == 0);
+	CHECK(cpu.available() == 0);
+	guard = guard_type<2>{};
+	CHECK(pool.available() == 1);
+	CHECK(cpu.available() == 4);
+}
+
+TEST_CASE("async_acquire_all opposite order does not deadlock", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore a{ctx.get_executor(), 1};
+	async_semaphore b{ctx.get_executor(), 1};
+
+	int done = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		auto handler = [&](boost::system::error_code ec, guard_type<2> g) {
+			CHECK(!ec);
+			CHECK(a.available() == 0);
+			CHECK(b.available() == 0);
+			++done;
+			// release later
+			auto held = std::make_shared<guard_type<2>>(std::move(g));
+			boost::asio::post(ctx, [held] {});
+		};
+		if (i % 2)
+			coma::async_acquire_all(a, 1, b, 1, handler);
+		else
+			coma::async_acquire_all(b, 1, a, 1, handler);
+	}
+	ctx.run();
+	CHECK(done == 10);
+	CHECK(a.available() == 1);
+	CHECK(b.available() == 1);
+}
+
+TEST_CASE("async_acquire_all error", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore a{ctx.get_executor(), 1};
+	async_semaphore b{ctx.get_executor(), 0};
+	b.set_max_waiters(0);
+
+	boost::system::error_code result;
+	bool owns = true;
+	coma::async_acquire_all(a, 1, b, 1, [&](boost::system::error_code ec, guard_type<2> g) {
+		result = ec;
+		owns = g.owns_acquire();
+	});
+	ctx.poll();
+	CHECK(result == coma::error::queue_full);
+	CHECK(!owns);
+	CHECK(a.available() == 1);
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_acquire_all default token", "[acquire_all]")
+{
+	using semaphore_d = boost::asio::detached_t::as_default_on_t<
+		coma::async_semaphore<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	semaphore_d a{ctx.get_executor(), 1};
+	semaphore_d b{ctx.get_executor(), 1};
+	coma::async_acquire_all(a, 1, b, 1);
+	ctx.poll();
+	// the guard was destroyed by the detached handler
+	CHECK(a.available() == 1);
+	CHECK(b.available() == 1);
+}
+#endif
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_acquire_all coro", "[acquire_all]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore a{ctx.get_executor(), 2};
+	async_semaphore b{ctx.get_executor(), 3};
+
+	int done = 0;
+	for (int i = 0; i < 6; ++i)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&]() -> awaitable<void> {
+				auto g = co_await coma::async_acquire_all(a, 1, b, 2, use_awaitable);
+				CHECK(g);
+				++done;
+			},
+			boost::asio::detached);
+	}
+	ctx.run();
+	CHECK(done == 6);
+	CHECK(a.available() == 2);
+	CHECK(b.available() == 3);
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include <coma/adaptive_limiter.hpp>
+#include <test_util.hpp>
+
+#include <chrono>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using limiter = coma::async_adaptive_limiter<>;
+#else
+using limiter = coma::async_adaptive_limiter<boost::asio::io_context::executor_type>;
+#endif
+
+using std::chrono::milliseconds;
+
+static_assert(!std::is_copy_constructible<limiter>::value, "");
+static_assert(!std::is_move_constructible<limiter>::value, "");
+
+TEST_CASE("adaptive_limiter ctor", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 4;
+	limiter l{ctx.get_executor(), aimd};
+	CHECK(l.limit() == 4);
+	CHECK(l.in_flight() == 0);
+}
+
+TEST_CASE("adaptive_limiter acquire up to limit", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 2;
+	limiter l{ctx.get_executor(), aimd};
+
+	int done = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		l.async_acquire([&](boost::system::error_code ec) {
+			CHECK(!ec);
+			++done;
+		});
+	}
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(l.in_flight() == 2);
+	CHECK(!l.try_acquire());
+
+	l.release();
+	ctx.poll();
+	CHECK(done == 3);
+	CHECK(l.in_flight() == 2);
+}
+
+TEST_CASE("adaptive_limiter aimd", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 10;
+	aimd.backoff = 0.5;
+	aimd.timeout = milliseconds{100};
+	limiter l{ctx.get_executor(), aimd};
+
+	// underused, the limit stays
+	REQUIRE(l.try_acquire());
+	l.release(milliseconds{1});
+	CHECK(l.limit() == 10);
+
+	for (int i = 0; i < 5; ++i)
+		REQUIRE(l.try_acquire());
+	l.release(milliseconds{1});
+	CHECK(l.limit() == 11);
+	CHECK(l.in_flight() == 4);
+
+	// slow request counts as drop
+	l.release(milliseconds{200});
+	CHECK(l.limit() == 5);
+	l.release(milliseconds{1}, true);
+	CHECK(l.limit() == 2);
+	CHECK(l.in_flight() == 2);
+	l.release();
+	l.release();
+	CHECK(l.in_flight() == 0);
+	CHECK(l.try_acquire());
+	CHECK(l.try_acquire());
+	CHECK(!l.try_acquire());
+}
+
+TEST_CASE("adaptive_limiter shrink while in flight", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 4;
+	limiter l{ctx.get_executor(), aimd};
+
+	for (int i = 0; i < 3; ++i)
+		REQUIRE(l.try_acquire());
+	l.set_limit(1);
+	CHECK(l.limit() == 1);
+	CHECK(l.in_flight() == 3);
+	CHECK(!l.try_acquire());
+
+	// releases pay back the debt first
+	l.release();
+	l.release();
+	CHECK(l.in_flight() == 1);
+	CHECK(!l.try_acquire());
+	l.release();
+	CHECK(l.in_flight() == 0);
+	CHECK(l.try_acquire());
+	CHECK(!l.try_acquire());
+
+	// growing pays remaining debt before adding permits
+	l.set_limit(2);
+	l.set_limit(1);
+	l.set_limit(3);
+	CHECK(l.in_flight() == 1);
+	CHECK(l.try_acquire());
+	CHECK(l.try_acquire());
+	CHECK(!l.try_acquire());
+}
+
+TEST_CASE("adaptive_limiter vegas", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::vegas_limit vegas;
+	vegas.initial = 10;
+	coma::async_adaptive_limiter<boost::asio::io_context::executor_type, coma::vegas_limit> l{
+		ctx.get_executor(), vegas};
+
+	for (int i = 0; i < 10; ++i)
+		REQUIRE(l.try_acquire());
+	// no queueing, grows
+	l.release(milliseconds{10});
+	CHECK(l.limit() == 11);
+	REQUIRE(l.try_acquire());
+	REQUIRE(l.try_acquire());
+	// latency tripled, queue estimate over beta, shrinks
+	l.release(milliseconds{30});
+	CHECK(l.limit() == 10);
+	l.release(milliseconds{10}, true);
+	CHECK(l.limit() == 9);
+}
+
+TEST_CASE("adaptive_limiter gradient", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::gradient_limit gradient;
+	gradient.initial = 16;
+	coma::async_adaptive_limiter<boost::asio::io_context::executor_type, coma::gradient_limit> l{
+		ctx.get_executor(), gradient};
+
+	for (int i = 0; i < 16; ++i)
+		REQUIRE(l.try_acquire());
+	// steady latency, the queue allowance grows the limit
+	for (int i = 0; i < 5; ++i)
+	{
+		l.release(milliseconds{10});
+		REQUIRE(l.try_acquire());
+	}
+	const auto grown = l.limit();
+	CHECK(grown > 16);
+	// latency far above the long-term average
+	for (int i = 0; i < 10; ++i)
+	{
+		l.release(milliseconds{100});
+		(void)l.try_acquire();
+	}
+	CHECK(l.limit() < 16);
+	CHECK(l.in_flight() <= 16);
+}
+
+TEST_CASE("adaptive_limiter limit_guard", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 2;
+	limiter l{ctx.get_executor(), aimd};
+
+	{
+		REQUIRE(l.try_acquire());
+		coma::limit_guard<limiter> g{l, coma::adapt_acquire};
+		CHECK(g.owns_acquire());
+		auto g2 = std::move(g);
+		CHECK(!g.owns_acquire());
+		CHECK(l.in_flight() == 1);
+	}
+	// sampled with in_flight 1 of 2, grows
+	CHECK(l.limit() == 3);
+	CHECK(l.in_flight() == 0);
+	{
+		REQUIRE(l.try_acquire());
+		coma::limit_guard<limiter> g{l, coma::adapt_acquire};
+		g.set_dropped();
+	}
+	CHECK(l.limit() == 2);
+	{
+		REQUIRE(l.try_acquire());
+		coma::limit_guard<limiter> g{l, coma::adapt_acquire};
+		g.release_without_sample();
+		CHECK(!g.owns_acquire());
+	}
+	CHECK(l.limit() == 2);
+	CHECK(l.in_flight() == 0);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("adaptive_limiter coro requests", "[adaptive_limiter]")
+{
+	boost::asio::io_context ctx;
+	coma::aimd_limit aimd;
+	aimd.initial = 2;
+	limiter l{ctx.get_executor(), aimd};
+
+	int max_in_flight = 0;
+	int done = 0;
+	for (int i = 0; i < 20; ++i)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&]() -> awaitable<void> {
+				co_await l.async_acquire(use_awaitable);
+				coma::limit_guard<limiter> g{l, coma::adapt_acquire};
+				max_in_flight = std::max(max_in_flight, static_cast<int>(l.in_flight()));
+				co_await boost::asio::post(ctx, use_awaitable);
+				++done;
+			},
+			boost::asio::detached);
+	}
+	ctx.run();
+	CHECK(done == 20);
+	CHECK(l.limit() > 2);
+	CHECK(l.in_flight() == 0);
+	CHECK(max_in_flight <= static_cast<int>(l.limit()));
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include <coma/async_acquire_guard.hpp>
+#include <coma/async_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <memory>
+#include <thread>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_semaphore<>;
+#else
+using async_semaphore = coma::async_semaphore<boost::asio::io_context::executor_type>;
+#endif
+
+using guard_type = coma::async_unique_acquire_guard<async_semaphore>;
+
+static_assert(!std::is_copy_constructible<guard_type>::value, "");
+static_assert(std::is_nothrow_move_constructible<guard_type>::value, "");
+static_assert(!std::is_copy_assignable<guard_type>::value, "");
+static_assert(std::is_nothrow_move_assignable<guard_type>::value, "");
+
+TEST_CASE("async_unique_acquire_guard ctor", "[async_unique_acquire_guard]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+	{
+		guard_type g{sem, coma::try_to_acquire};
+		CHECK(g);
+		CHECK(g.count() == 1);
+		CHECK(g.semaphore() == &sem);
+		guard_type d{sem, coma::defer_acquire};
+		CHECK(!d);
+		CHECK(d.count() == 0);
+		CHECK_THROWS_AS(d.release(), std::system_error);
+	}
+	ctx.poll();
+	CHECK(sem.available() == 2);
+
+	REQUIRE(sem.try_acquire_n(2));
+	guard_type g{sem, coma::adapt_acquire, 2};
+	CHECK(g.count() == 2);
+	auto* s = g.release_ownership();
+	CHECK(s == &sem);
+	CHECK(!g);
+	s->release(2);
+}
+
+TEST_CASE("async_unique_acquire_guard off executor posts", "[async_unique_acquire_guard]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 3};
+	REQUIRE(sem.try_acquire_n(3));
+	{
+		guard_type g{sem, coma::adapt_acquire, 3};
+		// not running on ctx
+	}
+	CHECK(sem.available() == 0);
+	// one post for all permits
+	CHECK(ctx.poll() == 1);
+	CHECK(sem.available() == 3);
+}
+
+TEST_CASE("async_unique_acquire_guard on executor inline", "[async_unique_acquire_guard]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	bool checked = false;
+	boost::asio::post(ctx, [&] {
+		REQUIRE(sem.try_acquire());
+		{
+			guard_type g{sem, coma::adapt_acquire};
+		}
+		CHECK(sem.available() == 1);
+		checked = true;
+	});
+	CHECK(ctx.poll() == 1);
+	CHECK(checked);
+}
+
+TEST_CASE("async_unique_acquire_guard strand", "[async_unique_acquire_guard]")
+{
+	using strand_semaphore =
+		coma::async_semaphore<boost::asio::strand<boost::asio::io_context::executor_type>>;
+	using strand_guard = coma::async_unique_acquire_guard<strand_semaphore>;
+
+	boost::asio::io_context ctx;
+	auto strand = boost::asio::make_strand(ctx.get_executor());
+	strand_semaphore sem{strand, 1};
+
+	int inline_releases = 0;
+	// on the io_context but not on the strand
+	boost::asio::post(ctx, [&] {
+		REQUIRE(sem.try_acquire());
+		strand_guard g{sem, coma::adapt_acquire};
+		g.release();
+		inline_releases += sem.available();
+	});
+	ctx.run();
+	ctx.restart();
+	CHECK(inline_releases == 0);
+	CHECK(sem.available() == 1);
+
+	boost::asio::post(strand, [&] {
+		REQUIRE(sem.try_acquire());
+		strand_guard g{sem, coma::adapt_acquire};
+		g.release();
+		inline_releases += sem.available();
+	});
+	ctx.run();
+	CHECK(inline_releases == 1);
+}
+
+TEST_CASE("async_unique_acquire_guard release from other thread", "[async_unique_acquire_guard]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		guard_type g{sem, coma::adapt_acquire};
+		// the permit moves to another thread which drops it
+		auto held = std::make_shared<guard_type>(std::move(g));
+		std::thread t{[held] { held->release(); }};
+		t.join();
+		++done;
+	});
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+		sem.release();
+	});
+	ctx.run();
+	CHECK(done == 2);
+	CHECK(sem.available() == 1);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_unique_acquire_guard coro", "[async_unique_acquire_guard]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+
+	int done = 0;
+	for (int i = 0; i < 6; ++i)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&]() -> awaitable<void> {
+				co_await sem.async_acquire(use_awaitable);
+				guard_type g{sem, coma::adapt_acquire};
+				co_await boost::asio::post(ctx, use_awaitable);
+				++done;
+			},
+			boost::asio::detached);
+	}
+	ctx.run();
+	CHECK(done == 6);
+	CHECK(sem.available() == 2);
+}
+
+#endif
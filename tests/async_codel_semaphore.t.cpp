@@ -0,0 +1,263 @@
+#include <coma/async_codel_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <vector>
+
+// manually advanced clock
+struct test_clock
+{
+	using duration = std::chrono::nanoseconds;
+	using rep = duration::rep;
+	using period = duration::period;
+	using time_point = std::chrono::time_point<test_clock>;
+	static const bool is_steady = true;
+
+	static time_point current;
+	static time_point now() noexcept { return current; }
+	static void advance(duration d) noexcept { current += d; }
+};
+test_clock::time_point test_clock::current{};
+
+using async_semaphore =
+	coma::async_codel_semaphore<boost::asio::io_context::executor_type, test_clock>;
+
+using std::chrono::milliseconds;
+
+static_assert(!std::is_copy_constructible<async_semaphore>::value, "");
+static_assert(!std::is_move_constructible<async_semaphore>::value, "");
+static_assert(!std::is_copy_assignable<async_semaphore>::value, "");
+static_assert(!std::is_move_assignable<async_semaphore>::value, "");
+
+TEST_CASE("async_codel_semaphore ctor", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+	coma::async_codel_semaphore<> sem{ctx.get_executor(), 0};
+#else
+	coma::async_codel_semaphore<boost::asio::io_context::executor_type> sem{ctx.get_executor(), 0};
+#endif
+	CHECK(!sem.overloaded());
+	CHECK(sem.params().target == milliseconds{5});
+}
+
+TEST_CASE("async_codel_semaphore error code", "[async_codel_semaphore]")
+{
+	boost::system::error_code ec = coma::error::dropped;
+	CHECK(ec == coma::error::dropped);
+	CHECK(ec != boost::asio::error::operation_aborted);
+	CHECK(std::string{ec.category().name()} == "coma");
+	CHECK(!ec.message().empty());
+}
+
+TEST_CASE("async_codel_semaphore try_acquire", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	{
+		coma::unique_acquire_guard<async_semaphore> g{sem, coma::try_to_acquire};
+		CHECK(g);
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+}
+
+TEST_CASE("async_codel_semaphore fifo while not overloaded", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	std::vector<int> order;
+	for (int i = 0; i < 3; ++i)
+	{
+		sem.async_acquire([&, i](boost::system::error_code ec) {
+			CHECK(!ec);
+			order.push_back(i);
+		});
+		test_clock::advance(milliseconds{1});
+	}
+	sem.release(3);
+	ctx.run();
+	CHECK(order == std::vector<int>{0, 1, 2});
+	CHECK(!sem.overloaded());
+}
+
+TEST_CASE("async_codel_semaphore lifo and drop under overload", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	coma::codel_params<test_clock> params;
+	params.target = milliseconds{5};
+	params.interval = milliseconds{100};
+	params.budget = milliseconds{50};
+	async_semaphore sem{ctx.get_executor(), 0, params};
+
+	std::vector<int> served;
+	std::vector<int> dropped;
+	auto acquire = [&](int id) {
+		sem.async_acquire([&, id](boost::system::error_code ec) {
+			if (ec)
+			{
+				CHECK(ec == coma::error::dropped);
+				dropped.push_back(id);
+			}
+			else
+				served.push_back(id);
+		});
+	};
+
+	// a standing queue, each waiter served after 20ms
+	for (int i = 0; i < 5; ++i)
+		acquire(i);
+	test_clock::advance(milliseconds{20});
+	sem.release();
+	ctx.poll();
+	CHECK(served == std::vector<int>{0});
+	CHECK(!sem.overloaded());
+
+	// interval ends with a minimum delay above target
+	test_clock::advance(milliseconds{100});
+	acquire(5);
+	CHECK(sem.overloaded());
+	// waiters 1 to 4 were parked for 120ms
+	ctx.poll();
+	CHECK(dropped == std::vector<int>{1, 2, 3, 4});
+
+	acquire(6);
+	test_clock::advance(milliseconds{1});
+	sem.release();
+	ctx.poll();
+	// newest first
+	CHECK(served == std::vector<int>{0, 6});
+
+	auto s = sem.stats();
+	CHECK(s.timeouts == 4);
+	CHECK(s.waiters == 1);
+	CHECK(s.acquires == 2);
+
+	// served quickly for an interval, back to fifo
+	test_clock::advance(milliseconds{100});
+	sem.release();
+	ctx.poll();
+	CHECK(served == std::vector<int>{0, 6, 5});
+	ctx.restart();
+	acquire(7);
+	acquire(8);
+	test_clock::advance(milliseconds{1});
+	sem.release();
+	ctx.poll();
+	test_clock::advance(milliseconds{100});
+	sem.release();
+	ctx.poll();
+	CHECK(!sem.overloaded());
+	CHECK(served == std::vector<int>{0, 6, 5, 7, 8});
+}
+
+TEST_CASE("async_codel_semaphore overload after the queue drained", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	coma::codel_params<test_clock> params;
+	params.target = milliseconds{5};
+	params.interval = milliseconds{100};
+	params.budget = milliseconds{50};
+	async_semaphore sem{ctx.get_executor(), 0, params};
+
+	int served = 0;
+	auto acquire = [&] {
+		sem.async_acquire([&](boost::system::error_code ec) {
+			CHECK(!ec);
+			++served;
+		});
+	};
+	// the only waiter of the interval is served after 20ms
+	acquire();
+	test_clock::advance(milliseconds{20});
+	sem.release();
+	ctx.poll();
+	CHECK(served == 1);
+	ctx.restart();
+
+	// the first park of the next interval still sees the served delay
+	test_clock::advance(milliseconds{100});
+	acquire();
+	CHECK(sem.overloaded());
+	sem.release();
+	ctx.poll();
+	CHECK(served == 2);
+}
+
+TEST_CASE("async_codel_semaphore drops without releases", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	coma::codel_params<test_clock> params;
+	params.interval = milliseconds{10};
+	params.budget = milliseconds{10};
+	async_semaphore sem{ctx.get_executor(), 0, params};
+
+	boost::system::error_code result;
+	sem.async_acquire([&](boost::system::error_code ec) { result = ec; });
+	ctx.poll();
+	test_clock::advance(milliseconds{50});
+	// the timer ends the interval and drops the waiter, then run returns
+	ctx.run();
+	CHECK(result == coma::error::dropped);
+	CHECK(sem.overloaded());
+	CHECK(sem.stats().timeouts == 1);
+	CHECK(sem.stats().waiters == 0);
+}
+
+TEST_CASE("async_codel_semaphore destroy with waiters", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_semaphore sem{ctx.get_executor(), 0};
+		sem.async_acquire([&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 1);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_codel_semaphore coro dropped", "[async_codel_semaphore]")
+{
+	boost::asio::io_context ctx;
+	coma::codel_params<test_clock> params;
+	params.interval = milliseconds{10};
+	params.budget = milliseconds{10};
+	async_semaphore sem{ctx.get_executor(), 0, params};
+
+	bool dropped = false;
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			try
+			{
+				co_await sem.async_acquire(use_awaitable);
+			}
+			catch (const boost::system::system_error& e)
+			{
+				dropped = e.code() == coma::error::dropped;
+			}
+		},
+		boost::asio::detached);
+	ctx.poll();
+	test_clock::advance(milliseconds{20});
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.run();
+	CHECK(dropped);
+	CHECK(sem.try_acquire());
+}
+
+#endif
@@ -154,6 +154,136 @@ TEST_CASE("async_cond_var wait many pred", "[async_cond_var]")
 	CHECK(done == 3);
 }
 
+TEST_CASE("async_cond_var stats", "[async_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+	bool ready = false;
+	cv.async_wait([](boost::system::error_code) {});
+	cv.async_wait([&] { return ready; }, [](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	CHECK(cv.stats().waiters == 2);
+	cv.notify_all();
+	ctx.poll();
+	ctx.restart();
+	auto s = cv.stats();
+	CHECK(s.waiters == 1);
+	CHECK(s.acquires == 1);
+	CHECK(s.wakeups == 2);
+	CHECK(s.spurious_wakeups == 1);
+	ready = true;
+	cv.notify_all();
+	ctx.poll();
+	s = cv.stats();
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 2);
+	CHECK(s.wakeups == 3);
+}
+
+TEST_CASE("async_cond_var notify_n", "[async_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	for (int i = 0; i < 5; ++i)
+	{
+		cv.async_wait([&, i](boost::system::error_code ec) {
+			CHECK(!ec);
+			CHECK(done == i);
+			++done;
+		});
+	}
+	ctx.poll();
+	CHECK(cv.notify_n(0) == 0);
+	CHECK(cv.notify_n(2) == 2);
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(cv.notify_n(5) == 3);
+	ctx.poll();
+	CHECK(done == 5);
+	CHECK(cv.notify_n(1) == 0);
+}
+
+TEST_CASE("async_cond_var wait versioned", "[async_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int items = 0;
+	int calls = 0;
+	int done = 0;
+	cv.async_wait_versioned(
+		[&] {
+			++calls;
+			return items > 0;
+		},
+		[&](boost::system::error_code ec) {
+			CHECK(!ec);
+			CHECK(items > 0);
+			++done;
+		});
+	ctx.poll();
+	CHECK(calls == 1);
+
+	// generation did not advance, pred() is not evaluated
+	cv.notify_all();
+	ctx.poll();
+	CHECK(calls == 1);
+	CHECK(done == 0);
+	CHECK(cv.stats().spurious_wakeups == 1);
+
+	CHECK(cv.advance() == 1);
+	CHECK(cv.generation() == 1);
+	cv.notify_all();
+	ctx.poll();
+	CHECK(calls == 2);
+	CHECK(done == 0);
+
+	++items;
+	cv.advance();
+	cv.notify_one();
+	ctx.poll();
+	CHECK(calls == 3);
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_cond_var batch producer", "[async_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int items = 0;
+	int consumed = 0;
+	int calls = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		cv.async_wait_versioned(
+			[&] {
+				++calls;
+				return items > 0;
+			},
+			[&](boost::system::error_code ec) {
+				CHECK(!ec);
+				--items;
+				++consumed;
+			});
+	}
+	ctx.poll();
+	CHECK(calls == 4);
+
+	items = 2;
+	cv.advance();
+	cv.notify_n(2);
+	ctx.poll();
+	CHECK(consumed == 2);
+	CHECK(items == 0);
+	CHECK(calls == 6);
+	CHECK(cv.stats().waiters == 2);
+}
+
 #if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
 
 using boost::asio::awaitable;
@@ -0,0 +1,479 @@
+#include <coma/async_cond_var_compact.hpp>
+#include <test_util.hpp>
+#include <boost/asio/strand.hpp>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_cond_var = coma::async_cond_var_compact<>;
+#else
+using async_cond_var = coma::async_cond_var_compact<boost::asio::io_context::executor_type>;
+#endif
+
+static_assert(!std::is_copy_constructible<async_cond_var>::value, "");
+static_assert(!std::is_move_constructible<async_cond_var>::value, "");
+static_assert(!std::is_copy_assignable<async_cond_var>::value, "");
+static_assert(!std::is_move_assignable<async_cond_var>::value, "");
+
+TEST_CASE("async_cond_var_compact ctor", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_cond_var_compact as default on detached", "[async_cond_var_compact]")
+{
+    using cv_d = boost::asio::detached_t::as_default_on_t<coma::async_cond_var_compact<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	cv_d cv{ctx.get_executor()};
+    cv.async_wait();
+}
+#endif
+
+TEST_CASE("async_cond_var_compact wait", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { cv.notify_one(); });
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_cond_var_compact wait race condition", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int val = 0;
+	int val_in_pred = 0;
+
+	boost::asio::post(ctx, [&] {
+		boost::asio::post(ctx, [&] { ++val; });
+		CHECK(val == 0);
+		// verify that initially true pred will also be
+		// true inside handler
+		cv.async_wait([&] {
+				val_in_pred = val;
+				return true;
+			},
+			[&](boost::system::error_code ec) {
+				CHECK(!ec);
+				CHECK(val == val_in_pred);
+				++val;
+			});
+	});
+	ctx.run();
+	CHECK(val == 2);
+}
+
+TEST_CASE("async_cond_var_compact wait many fifo", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 0);
+		done = 1;
+	});
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 1);
+		done = 2;
+	});
+	boost::asio::post(ctx, [&] { cv.notify_all(); });
+
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_cond_var_compact wait many fifo one", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 0);
+		done = 1;
+	});
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 1);
+		done = 2;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+	cv.notify_one();
+	ctx.poll();
+	CHECK(done == 1);
+	cv.notify_one();
+	ctx.poll();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_cond_var_compact wait many pred", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait(coma::make_logged_fn([&] { return done == 2; }),
+				  [&](boost::system::error_code ec) {
+					  CHECK(!ec);
+					  CHECK(done == 2);
+					  done = 3;
+				  });
+	cv.async_wait(coma::make_logged_fn([&] { return done == 1; }),
+				  [&](boost::system::error_code ec) {
+					  CHECK(!ec);
+					  CHECK(done == 1);
+					  done = 2;
+					  cv.notify_all();
+				  });
+
+	cv.notify_all();
+	ctx.poll();
+	CHECK(done == 0);
+
+	CHECK(coma::run_would_block(ctx));
+
+	done = 1;
+	cv.notify_all();
+
+	ctx.run();
+	CHECK(done == 3);
+}
+
+TEST_CASE("async_cond_var_compact pred strand", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	boost::asio::strand<typename boost::asio::io_context::executor_type> strand{ctx.get_executor()};
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	bool p = false;
+	cv.async_wait([&] {
+			CHECK(strand.running_in_this_thread());
+			return p;
+		}, boost::asio::bind_executor(strand,
+		[&](boost::system::error_code ec) {
+			CHECK(strand.running_in_this_thread());
+			CHECK(!ec);
+			CHECK(done == 0);
+			done = 1;
+		}));
+	ctx.poll();
+	CHECK(done == 0);
+	p = true;
+	cv.notify_one();
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_cond_var_compact pred handler executor", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	boost::asio::io_context other;
+	async_cond_var cv{ctx.get_executor()};
+
+	int checks = 0;
+	int done = 0;
+	cv.async_wait([&] { return ++checks > 1; },
+				  boost::asio::bind_executor(other.get_executor(),
+											 [&](boost::system::error_code ec) {
+												 CHECK(!ec);
+												 ++done;
+											 }));
+	// the initial check runs on the handler's executor
+	ctx.poll();
+	ctx.restart();
+	CHECK(checks == 0);
+	other.poll();
+	other.restart();
+	CHECK(checks == 1);
+	cv.notify_one();
+	ctx.poll();
+	CHECK(checks == 1);
+	other.poll();
+	CHECK(checks == 2);
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_cond_var_compact destroy with waiters", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_cond_var cv{ctx.get_executor()};
+		cv.async_wait([&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		cv.async_wait([] { return false; }, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_cond_var_compact stats", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+	bool ready = false;
+	cv.async_wait([](boost::system::error_code) {});
+	cv.async_wait([&] { return ready; }, [](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	CHECK(cv.stats().waiters == 2);
+	cv.notify_all();
+	ctx.poll();
+	ctx.restart();
+	auto s = cv.stats();
+	CHECK(s.waiters == 1);
+	CHECK(s.acquires == 1);
+	CHECK(s.wakeups == 2);
+	CHECK(s.spurious_wakeups == 1);
+	ready = true;
+	cv.notify_all();
+	ctx.poll();
+	s = cv.stats();
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 2);
+	CHECK(s.wakeups == 3);
+}
+
+TEST_CASE("async_cond_var_compact without stats", "[async_cond_var_compact]")
+{
+	using executor = boost::asio::io_context::executor_type;
+	using uncounted = coma::async_cond_var_compact<executor, coma::predicate_check::on_resume,
+												   coma::wait_stats_mode::none>;
+	static_assert(sizeof(uncounted) < sizeof(coma::async_cond_var_compact<executor>), "");
+
+	boost::asio::io_context ctx;
+	uncounted cv{ctx.get_executor()};
+	bool ready = false;
+	int done = 0;
+	cv.async_wait([&](boost::system::error_code) { ++done; });
+	cv.async_wait([&] { return ready; }, [&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	ctx.restart();
+	cv.notify_all();
+	ctx.poll();
+	ctx.restart();
+	CHECK(done == 1);
+	ready = true;
+	cv.notify_all();
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(cv.stats().wakeups == 0);
+	CHECK(cv.stats().peak_waiters == 0);
+}
+
+using cv_on_notify = coma::async_cond_var_compact<boost::asio::io_context::executor_type,
+													coma::predicate_check::on_notify>;
+
+TEST_CASE("async_cond_var_compact on_notify skips false predicates", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	cv_on_notify cv{ctx.get_executor()};
+
+	int state = 0;
+	int calls1 = 0;
+	int calls2 = 0;
+	int done = 0;
+	cv.async_wait([&] {
+			++calls1;
+			return state == 1;
+		},
+		[&](boost::system::error_code ec) {
+			CHECK(!ec);
+			CHECK(state == 1);
+			done += 1;
+		});
+	cv.async_wait([&] {
+			++calls2;
+			return state == 2;
+		},
+		[&](boost::system::error_code ec) {
+			CHECK(!ec);
+			done += 10;
+		});
+	ctx.poll();
+	CHECK(calls1 == 1);
+	CHECK(calls2 == 1);
+
+	// evaluated synchronously, nothing is posted for false predicates
+	cv.notify_all();
+	CHECK(calls1 == 2);
+	CHECK(calls2 == 2);
+	CHECK(coma::run_would_block(ctx));
+	CHECK(done == 0);
+
+	state = 1;
+	cv.notify_all();
+	CHECK(calls1 == 3);
+	CHECK(calls2 == 3);
+	ctx.poll();
+	CHECK(done == 1);
+	// the handler does not evaluate the predicate again
+	CHECK(calls1 == 3);
+
+	state = 2;
+	cv.notify_one();
+	ctx.poll();
+	CHECK(done == 11);
+	CHECK(calls2 == 4);
+
+	auto s = cv.stats();
+	CHECK(s.waiters == 0);
+	CHECK(s.acquires == 2);
+	CHECK(s.wakeups == 2);
+	CHECK(s.spurious_wakeups == 0);
+}
+
+TEST_CASE("async_cond_var_compact on_notify notify_one first ready", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	cv_on_notify cv{ctx.get_executor()};
+
+	bool ready2 = false;
+	int done = 0;
+	cv.async_wait([] { return false; }, [&](boost::system::error_code) { done = -1; });
+	cv.async_wait([&] { return ready2; }, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		done = 2;
+	});
+	cv.async_wait([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		done = 3;
+	});
+	ctx.poll();
+
+	// plain waits are always ready
+	cv.notify_one();
+	ctx.poll();
+	CHECK(done == 3);
+
+	ready2 = true;
+	cv.notify_one();
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(cv.stats().waiters == 1);
+}
+
+TEST_CASE("async_cond_var_compact on_notify initially true", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	cv_on_notify cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait([] { return true; }, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_cond_var_compact on_notify destroy with waiters", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		cv_on_notify cv{ctx.get_executor()};
+		cv.async_wait([&](boost::system::error_code ec) {
+			CHECK(!ec);
+			++done;
+		});
+		cv.async_wait([] { return false; }, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+		cv.notify_all();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_cond_var_compact coro as default on", "[async_cond_var_compact]")
+{
+	using cond_var_coro = boost::asio::use_awaitable_t<>::as_default_on_t<coma::async_cond_var_compact<boost::asio::io_context::executor_type>>;
+
+	boost::asio::io_context ctx;
+	cond_var_coro cv{ctx.get_executor()};
+
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await cv.async_wait(coma::logged_fn([&] { return true; }));
+		},
+		boost::asio::detached);
+	ctx.run();
+}
+#endif
+
+TEST_CASE("async_cond_var_compact coro wait many pred", "[async_cond_var_compact]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			TEST_LOG("before await");
+			co_await cv.async_wait(coma::logged_fn([&] { return done == 2; }), use_awaitable);
+			TEST_LOG("after await");
+			CHECK(done == 2);
+			done = 3;
+		},
+		boost::asio::detached);
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			TEST_LOG("before await");
+			co_await cv.async_wait(coma::logged_fn([&] { return done == 1; }), use_awaitable);
+			TEST_LOG("after await");
+			CHECK(done == 1);
+			done = 2;
+			cv.notify_all();
+		},
+		boost::asio::detached);
+
+	boost::asio::post(ctx, [&] { cv.notify_all(); });
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] {
+		done = 1;
+		cv.notify_all();
+	});
+
+	ctx.run();
+	CHECK(done == 3);
+}
+
+#endif
@@ -490,6 +490,32 @@ TEST_CASE("async_cond_var_timed pred strand", "[async_cond_var_timed]")
 	CHECK(done == 1);
 }
 
+TEST_CASE("async_cond_var_timed stats", "[async_cond_var_timed]")
+{
+	boost::asio::io_context ctx;
+	async_cond_var cv{ctx.get_executor()};
+	bool timed_done = false, untimed_done = false;
+	cv.async_wait_for(std::chrono::milliseconds{1},
+					  [&](boost::system::error_code, coma::cv_status) { timed_done = true; });
+	cv.async_wait([&](boost::system::error_code) { untimed_done = true; });
+	while (!timed_done || !untimed_done)
+		ctx.run_one();
+	ctx.poll();
+	ctx.restart();
+	auto s = cv.stats();
+	CHECK(s.timeouts == 1);
+	// the expiry also resumes the untimed wait
+	CHECK(s.acquires == 1);
+	cv.stop();
+	cv.async_wait([](boost::system::error_code) {});
+	ctx.poll();
+	s = cv.stats();
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 1);
+	CHECK(s.cancellations == 1);
+}
+
 #if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
 
 using boost::asio::awaitable;
@@ -0,0 +1,221 @@
+#include <coma/async_edf_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <chrono>
+#include <vector>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_edf_semaphore<>;
+#else
+using async_semaphore = coma::async_edf_semaphore<boost::asio::io_context::executor_type>;
+#endif
+
+using clock_type = async_semaphore::clock_type;
+using std::chrono::milliseconds;
+
+static_assert(!std::is_copy_constructible<async_semaphore>::value, "");
+static_assert(!std::is_move_constructible<async_semaphore>::value, "");
+static_assert(!std::is_copy_assignable<async_semaphore>::value, "");
+static_assert(!std::is_move_assignable<async_semaphore>::value, "");
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_edf_semaphore as default on detached", "[async_edf_semaphore]")
+{
+	using semaphore_d = boost::asio::detached_t::as_default_on_t<
+		coma::async_edf_semaphore<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	semaphore_d sem{ctx.get_executor(), 0};
+	sem.async_acquire();
+	sem.async_acquire_for(milliseconds{1});
+}
+#endif
+
+TEST_CASE("async_edf_semaphore try_acquire", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	{
+		coma::unique_acquire_guard<async_semaphore> g{sem, coma::try_to_acquire};
+		CHECK(g);
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+
+	// parked waiters are served first
+	sem.async_acquire_n_until(2, clock_type::now() + std::chrono::hours{1},
+							  [](boost::system::error_code) {});
+	sem.release();
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	REQUIRE(!sem.try_acquire());
+}
+
+TEST_CASE("async_edf_semaphore earliest deadline first", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	const auto now = clock_type::now();
+
+	std::vector<int> order;
+	auto push = [&](int i) {
+		return [&order, i](boost::system::error_code ec) {
+			CHECK(!ec);
+			order.push_back(i);
+		};
+	};
+	sem.async_acquire(push(0));
+	sem.async_acquire_until(now + std::chrono::hours{3}, push(3));
+	sem.async_acquire_until(now + std::chrono::hours{1}, push(1));
+	sem.async_acquire(push(4));
+	sem.async_acquire_until(now + std::chrono::hours{2}, push(2));
+	// equal deadlines keep FIFO order
+	sem.async_acquire_until(now + std::chrono::hours{1}, push(11));
+	ctx.poll();
+	CHECK(sem.stats().waiters == 6);
+
+	sem.release(6);
+	ctx.poll();
+	CHECK(order == std::vector<int>{1, 11, 2, 3, 0, 4});
+	CHECK(sem.stats().waiters == 0);
+	CHECK(sem.stats().acquires == 6);
+}
+
+TEST_CASE("async_edf_semaphore expired deadline", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	boost::system::error_code result;
+	sem.async_acquire_until(clock_type::now() - milliseconds{1},
+							[&](boost::system::error_code ec) { result = ec; });
+	ctx.poll();
+	CHECK(result == boost::asio::error::timed_out);
+	// no permit was taken
+	CHECK(sem.try_acquire());
+	CHECK(sem.stats().timeouts == 1);
+}
+
+TEST_CASE("async_edf_semaphore drops at deadline", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+	REQUIRE(sem.try_acquire());
+
+	boost::system::error_code first, second;
+	bool first_done = false, second_done = false;
+	// the first deadline has already passed, the second can't pass during the test
+	sem.async_acquire_until(clock_type::now() - milliseconds{1}, [&](boost::system::error_code ec) {
+		first = ec;
+		first_done = true;
+	});
+	sem.async_acquire_for(std::chrono::hours{1}, [&](boost::system::error_code ec) {
+		second = ec;
+		second_done = true;
+	});
+
+	while (!first_done)
+		ctx.run_one();
+	CHECK(first == boost::asio::error::timed_out);
+	CHECK(!second_done);
+	CHECK(sem.stats().waiters == 1);
+
+	// the next waiter can still meet its deadline
+	sem.release();
+	ctx.run();
+	CHECK(second_done);
+	CHECK(!second);
+	CHECK(sem.stats().acquires == 2);
+	CHECK(sem.stats().timeouts == 1);
+}
+
+TEST_CASE("async_edf_semaphore drop unblocks later waiters", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	boost::system::error_code big, small;
+	std::vector<int> order;
+	// needs more permits than available, blocks the waiter behind it
+	sem.async_acquire_n_until(2, clock_type::now() + milliseconds{10},
+							  [&](boost::system::error_code ec) {
+								  big = ec;
+								  order.push_back(1);
+							  });
+	sem.async_acquire([&](boost::system::error_code ec) {
+		small = ec;
+		order.push_back(2);
+	});
+	ctx.run();
+	CHECK(big == boost::asio::error::timed_out);
+	CHECK(!small);
+	CHECK(order == std::vector<int>{1, 2});
+}
+
+TEST_CASE("async_edf_semaphore no timer without deadlines", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	bool done = false;
+	sem.async_acquire_for(std::chrono::hours{1}, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		done = true;
+	});
+	sem.release();
+	// the timer is cancelled once the waiter is served, run returns
+	ctx.run();
+	CHECK(done);
+}
+
+TEST_CASE("async_edf_semaphore destroy with waiters", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_semaphore sem{ctx.get_executor(), 0};
+		sem.async_acquire([&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		sem.async_acquire_for(std::chrono::hours{1}, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_edf_semaphore coro", "[async_edf_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	int done = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&]() -> awaitable<void> {
+				co_await sem.async_acquire_for(std::chrono::seconds{10}, use_awaitable);
+				++done;
+				sem.release();
+			},
+			boost::asio::detached);
+	}
+	ctx.run();
+	CHECK(done == 4);
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <coma/async_fair_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <string>
+#include <vector>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_fair_semaphore<int>;
+#else
+using async_semaphore = coma::async_fair_semaphore<int, boost::asio::io_context::executor_type>;
+#endif
+
+static_assert(!std::is_copy_constructible<async_semaphore>::value, "");
+static_assert(!std::is_move_constructible<async_semaphore>::value, "");
+static_assert(!std::is_copy_assignable<async_semaphore>::value, "");
+static_assert(!std::is_move_assignable<async_semaphore>::value, "");
+
+namespace {
+struct record
+{
+	std::vector<int>* order;
+	int tenant;
+	void operator()(boost::system::error_code ec) const
+	{
+		CHECK(!ec);
+		order->push_back(tenant);
+	}
+};
+} // namespace
+
+TEST_CASE("async_fair_semaphore ctor", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	CHECK(sem.tenant_count() == 0);
+	CHECK(sem.weight(1) == 1);
+	sem.set_weight(1, 4);
+	CHECK(sem.weight(1) == 4);
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_fair_semaphore as default on detached", "[async_fair_semaphore]")
+{
+	using semaphore_d = boost::asio::detached_t::as_default_on_t<
+		coma::async_fair_semaphore<int, boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	semaphore_d sem{ctx.get_executor(), 0};
+	sem.async_acquire(1);
+	sem.async_acquire_n(1, 2);
+}
+#endif
+
+TEST_CASE("async_fair_semaphore try_acquire", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	{
+		coma::unique_acquire_guard<async_semaphore> g{sem, coma::try_to_acquire};
+		CHECK(g);
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+
+	// parked waiters are served first
+	sem.async_acquire_n(1, 2, [](boost::system::error_code) {});
+	sem.release();
+	REQUIRE(!sem.try_acquire());
+}
+
+TEST_CASE("async_fair_semaphore uncontended", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+
+	std::vector<int> order;
+	sem.async_acquire(1, record{&order, 1});
+	sem.async_acquire(2, record{&order, 2});
+	// no queue is created without waiting tasks
+	CHECK(sem.tenant_count() == 0);
+	ctx.poll();
+	CHECK(order == std::vector<int>{1, 2});
+	CHECK(sem.stats().acquires == 2);
+}
+
+TEST_CASE("async_fair_semaphore round robin", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	std::vector<int> order;
+	// the noisy tenant 1 parks first
+	for (int i = 0; i < 6; ++i)
+		sem.async_acquire(1, record{&order, 1});
+	sem.async_acquire(2, record{&order, 2});
+	sem.async_acquire(2, record{&order, 2});
+	CHECK(sem.tenant_count() == 2);
+	CHECK(sem.stats().waiters == 8);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		sem.release();
+		ctx.poll();
+	}
+	CHECK(order == std::vector<int>{1, 2, 1, 2, 1, 1, 1, 1});
+	// queues are removed once empty
+	CHECK(sem.tenant_count() == 0);
+	CHECK(sem.stats().waiters == 0);
+	CHECK(sem.stats().acquires == 8);
+}
+
+TEST_CASE("async_fair_semaphore weights", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	sem.set_weight(1, 3);
+
+	std::vector<int> order;
+	for (int i = 0; i < 6; ++i)
+		sem.async_acquire(1, record{&order, 1});
+	for (int i = 0; i < 3; ++i)
+		sem.async_acquire(2, record{&order, 2});
+
+	sem.release(9);
+	ctx.poll();
+	CHECK(order == std::vector<int>{1, 1, 1, 2, 1, 1, 1, 2, 2});
+}
+
+TEST_CASE("async_fair_semaphore acquire n above quantum", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	std::vector<int> order;
+	sem.async_acquire_n(1, 3, record{&order, 1});
+	for (int i = 0; i < 4; ++i)
+		sem.async_acquire(2, record{&order, 2});
+
+	// tenant 1 collects its deficit over three rounds
+	sem.release(7);
+	ctx.poll();
+	CHECK(order == std::vector<int>{2, 2, 1, 2, 2});
+	CHECK(sem.tenant_count() == 0);
+}
+
+TEST_CASE("async_fair_semaphore string keys", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	coma::async_fair_semaphore<std::string, boost::asio::io_context::executor_type> sem{
+		ctx.get_executor(), 0};
+
+	std::vector<int> order;
+	sem.async_acquire("a", record{&order, 1});
+	sem.async_acquire("a", record{&order, 1});
+	sem.async_acquire("b", record{&order, 2});
+	sem.release(3);
+	ctx.poll();
+	CHECK(order == std::vector<int>{1, 2, 1});
+}
+
+TEST_CASE("async_fair_semaphore destroy with waiters", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_semaphore sem{ctx.get_executor(), 0};
+		sem.async_acquire(1, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		sem.async_acquire(2, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_fair_semaphore coro", "[async_fair_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	int done = 0;
+	for (int i = 0; i < 6; ++i)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&, i]() -> awaitable<void> {
+				co_await sem.async_acquire(i % 2, use_awaitable);
+				++done;
+				sem.release();
+			},
+			boost::asio::detached);
+	}
+	ctx.run();
+	CHECK(done == 6);
+}
+
+#endif
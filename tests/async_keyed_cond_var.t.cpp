@@ -0,0 +1,280 @@
+#include <coma/async_keyed_cond_var.hpp>
+#include <test_util.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <string>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_keyed_cond_var = coma::async_keyed_cond_var<int>;
+#else
+using async_keyed_cond_var =
+	coma::async_keyed_cond_var<int, boost::asio::io_context::executor_type>;
+#endif
+
+static_assert(!std::is_copy_constructible<async_keyed_cond_var>::value, "");
+static_assert(!std::is_move_constructible<async_keyed_cond_var>::value, "");
+static_assert(!std::is_copy_assignable<async_keyed_cond_var>::value, "");
+static_assert(!std::is_move_assignable<async_keyed_cond_var>::value, "");
+
+TEST_CASE("async_keyed_cond_var ctor", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+	CHECK(cv.key_count() == 0);
+}
+
+TEST_CASE("async_keyed_cond_var wait", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait(1, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+	CHECK(cv.key_count() == 1);
+
+	boost::asio::post(ctx, [&] { cv.notify_one(1); });
+	ctx.run();
+	CHECK(done == 1);
+	CHECK(cv.key_count() == 0);
+}
+
+TEST_CASE("async_keyed_cond_var notify only wakes key", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	int done1 = 0;
+	int done2 = 0;
+	cv.async_wait(1, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done1;
+	});
+	cv.async_wait(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done2;
+	});
+	cv.async_wait(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done2;
+	});
+	CHECK(cv.key_count() == 2);
+
+	cv.notify_all(3);
+	cv.notify_one(3);
+	cv.notify_all(2);
+	ctx.poll();
+	CHECK(done1 == 0);
+	CHECK(done2 == 2);
+	CHECK(cv.key_count() == 1);
+
+	cv.notify_one(1);
+	ctx.run();
+	CHECK(done1 == 1);
+	CHECK(cv.key_count() == 0);
+}
+
+TEST_CASE("async_keyed_cond_var wait fifo per key", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	int done = 0;
+	cv.async_wait(7, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 0);
+		done = 1;
+	});
+	cv.async_wait(7, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 1);
+		done = 2;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+	cv.notify_one(7);
+	ctx.poll();
+	CHECK(done == 1);
+	cv.notify_one(7);
+	ctx.poll();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_keyed_cond_var wait pred", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	int credit1 = 0;
+	int pred2_calls = 0;
+	int done = 0;
+	cv.async_wait(1, coma::make_logged_fn([&] { return credit1 > 0; }),
+				  [&](boost::system::error_code ec) {
+					  CHECK(!ec);
+					  CHECK(credit1 > 0);
+					  ++done;
+				  });
+	cv.async_wait(2, [&] {
+			++pred2_calls;
+			return false;
+		},
+		[&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	CHECK(pred2_calls == 1);
+
+	// spurious for key 1, parked under the same key again
+	cv.notify_all(1);
+	ctx.poll();
+	CHECK(done == 0);
+	CHECK(cv.key_count() == 2);
+
+	credit1 = 1;
+	cv.notify_one(1);
+	ctx.poll();
+	CHECK(done == 1);
+	CHECK(pred2_calls == 1);
+	CHECK(cv.key_count() == 1);
+	CHECK(cv.stats().spurious_wakeups == 1);
+}
+
+TEST_CASE("async_keyed_cond_var notify all keys", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	bool ready = false;
+	int done = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		cv.async_wait(i, [&](boost::system::error_code) { ++done; });
+		cv.async_wait(i, [&] { return ready; }, [&](boost::system::error_code) { ++done; });
+	}
+	ctx.poll();
+	CHECK(cv.key_count() == 4);
+
+	cv.notify_all();
+	ctx.poll();
+	CHECK(done == 4);
+	CHECK(cv.key_count() == 4);
+
+	ready = true;
+	cv.notify_all();
+	ctx.run();
+	CHECK(done == 8);
+	CHECK(cv.key_count() == 0);
+}
+
+TEST_CASE("async_keyed_cond_var string keys strand", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	boost::asio::strand<typename boost::asio::io_context::executor_type> strand{ctx.get_executor()};
+	coma::async_keyed_cond_var<std::string, boost::asio::io_context::executor_type> cv{
+		ctx.get_executor()};
+
+	int done = 0;
+	bool p = false;
+	cv.async_wait("stream-1", [&] {
+			CHECK(strand.running_in_this_thread());
+			return p;
+		}, boost::asio::bind_executor(strand,
+		[&](boost::system::error_code ec) {
+			CHECK(strand.running_in_this_thread());
+			CHECK(!ec);
+			done = 1;
+		}));
+	ctx.poll();
+	CHECK(done == 0);
+	p = true;
+	cv.notify_one("stream-2");
+	ctx.poll();
+	CHECK(done == 0);
+	cv.notify_one("stream-1");
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_keyed_cond_var destroy with waiters", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_keyed_cond_var cv{ctx.get_executor()};
+		cv.async_wait(1, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		cv.async_wait(2, [] { return false; }, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_keyed_cond_var stats", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+	cv.async_wait(1, [](boost::system::error_code) {});
+	cv.async_wait(2, [](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	CHECK(cv.stats().waiters == 2);
+	cv.notify_all(1);
+	ctx.poll();
+	auto s = cv.stats();
+	CHECK(s.waiters == 1);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 1);
+	CHECK(s.wakeups == 1);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_keyed_cond_var coro wait pred", "[async_keyed_cond_var]")
+{
+	boost::asio::io_context ctx;
+	async_keyed_cond_var cv{ctx.get_executor()};
+
+	int window[2] = {0, 0};
+	int done = 0;
+	for (int key = 0; key < 2; ++key)
+	{
+		boost::asio::co_spawn(
+			ctx,
+			[&, key]() -> awaitable<void> {
+				co_await cv.async_wait(key, [&, key] { return window[key] > 0; }, use_awaitable);
+				--window[key];
+				++done;
+			},
+			boost::asio::detached);
+	}
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] {
+		window[1] = 1;
+		cv.notify_one(1);
+	});
+	ctx.poll();
+	CHECK(done == 1);
+	CHECK(window[1] == 0);
+
+	boost::asio::post(ctx, [&] {
+		window[0] = 1;
+		cv.notify_one(0);
+	});
+	ctx.run();
+	CHECK(done == 2);
+}
+
+#endif
@@ -0,0 +1,238 @@
+#include <coma/async_priority_semaphore.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <vector>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_priority_semaphore<>;
+#else
+using async_semaphore = coma::async_priority_semaphore<boost::asio::io_context::executor_type>;
+#endif
+
+static_assert(!std::is_copy_constructible<async_semaphore>::value, "");
+static_assert(!std::is_move_constructible<async_semaphore>::value, "");
+static_assert(!std::is_copy_assignable<async_semaphore>::value, "");
+static_assert(!std::is_move_assignable<async_semaphore>::value, "");
+
+TEST_CASE("async_priority_semaphore ctor", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0, 3};
+	CHECK(sem.levels() == 3);
+	async_semaphore sem0{ctx.get_executor(), 0, 0};
+	CHECK(sem0.levels() == 1);
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_priority_semaphore as default on detached", "[async_priority_semaphore]")
+{
+	using semaphore_d = boost::asio::detached_t::as_default_on_t<
+		coma::async_priority_semaphore<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	semaphore_d sem{ctx.get_executor(), 0, 2};
+	sem.async_acquire();
+	sem.async_acquire(0);
+}
+#endif
+
+TEST_CASE("async_priority_semaphore try_acquire", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1, 2};
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	{
+		coma::unique_acquire_guard<async_semaphore> g{sem, coma::try_to_acquire};
+		CHECK(g);
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+
+	// parked waiters are served first
+	sem.async_acquire(1, [](boost::system::error_code) {});
+	sem.release(2);
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+}
+
+TEST_CASE("async_priority_semaphore async_acquire immediate", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2, 2};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem.async_acquire(0, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.run();
+	CHECK(done == 2);
+	CHECK(!sem.try_acquire());
+}
+
+TEST_CASE("async_priority_semaphore highest level first", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0, 3};
+
+	std::vector<int> order;
+	auto acquire = [&](std::size_t prio, int id) {
+		sem.async_acquire(prio, [&, id](boost::system::error_code ec) {
+			CHECK(!ec);
+			order.push_back(id);
+		});
+	};
+	acquire(2, 1);
+	acquire(1, 2);
+	acquire(2, 3);
+	acquire(0, 4);
+	acquire(1, 5);
+	ctx.poll();
+	CHECK(order.empty());
+
+	sem.release(5);
+	ctx.run();
+	CHECK(order == std::vector<int>{4, 2, 5, 1, 3});
+}
+
+TEST_CASE("async_priority_semaphore acquire_n head of line", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0, 2};
+
+	std::vector<int> order;
+	sem.async_acquire_n(2, 0, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		order.push_back(1);
+	});
+	sem.async_acquire(1, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		order.push_back(2);
+	});
+	sem.release();
+	ctx.poll();
+	// the lower level does not bypass the higher one
+	CHECK(order.empty());
+	sem.release(2);
+	ctx.poll();
+	CHECK(order == std::vector<int>{1, 2});
+}
+
+TEST_CASE("async_priority_semaphore aging", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	// promoted by one level for every 2 grants
+	async_semaphore sem{ctx.get_executor(), 0, 3, 2};
+
+	std::vector<int> order;
+	auto acquire = [&](std::size_t prio, int id) {
+		sem.async_acquire(prio, [&, id](boost::system::error_code ec) {
+			CHECK(!ec);
+			order.push_back(id);
+		});
+	};
+	acquire(2, 100);
+	for (int i = 0; i < 6; ++i)
+		acquire(0, i);
+
+	for (int i = 0; i < 7; ++i)
+		sem.release();
+	ctx.run();
+	// after 4 grants the batch waiter reached level 0 and is older
+	CHECK(order == std::vector<int>{0, 1, 2, 3, 100, 4, 5});
+}
+
+TEST_CASE("async_priority_semaphore without aging starves", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0, 2};
+
+	int low = 0;
+	int high = 0;
+	sem.async_acquire(1, [&](boost::system::error_code) { ++low; });
+	for (int i = 0; i < 10; ++i)
+	{
+		sem.async_acquire(0, [&](boost::system::error_code) { ++high; });
+		sem.release();
+		ctx.poll();
+	}
+	CHECK(high == 10);
+	CHECK(low == 0);
+	sem.release();
+	ctx.poll();
+	CHECK(low == 1);
+}
+
+TEST_CASE("async_priority_semaphore destroy with waiters", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_semaphore sem{ctx.get_executor(), 0, 2};
+		sem.async_acquire(0, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		sem.async_acquire(1, [&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_priority_semaphore stats", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1, 2};
+	CHECK(sem.try_acquire());
+	sem.async_acquire(0, [](boost::system::error_code) {});
+	sem.async_acquire(1, [](boost::system::error_code) {});
+	ctx.poll();
+	auto s = sem.stats();
+	CHECK(s.waiters == 2);
+	CHECK(s.acquires == 1);
+	sem.release(2);
+	ctx.poll();
+	s = sem.stats();
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 3);
+	CHECK(s.wakeups == 2);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_priority_semaphore coro interactive before batch", "[async_priority_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1, 2};
+
+	std::vector<int> order;
+	auto task = [&](std::size_t prio, int id) -> awaitable<void> {
+		co_await sem.async_acquire(prio, use_awaitable);
+		coma::acquire_guard<async_semaphore> g{sem, coma::adapt_acquire};
+		order.push_back(id);
+		co_await boost::asio::post(ctx, use_awaitable);
+	};
+	for (int i = 0; i < 3; ++i)
+		boost::asio::co_spawn(ctx, task(1, i), boost::asio::detached);
+	for (int i = 10; i < 13; ++i)
+		boost::asio::co_spawn(ctx, task(0, i), boost::asio::detached);
+	ctx.run();
+	CHECK(order == std::vector<int>{0, 10, 11, 12, 1, 2});
+}
+
+#endif
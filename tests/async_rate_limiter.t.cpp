@@ -0,0 +1,176 @@
+#include <coma/async_rate_limiter.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <chrono>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_rate_limiter = coma::async_rate_limiter<>;
+#else
+using async_rate_limiter = coma::async_rate_limiter<boost::asio::io_context::executor_type>;
+#endif
+
+using clock_type = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+static_assert(!std::is_copy_constructible<async_rate_limiter>::value, "");
+static_assert(!std::is_move_constructible<async_rate_limiter>::value, "");
+static_assert(!std::is_copy_assignable<async_rate_limiter>::value, "");
+static_assert(!std::is_move_assignable<async_rate_limiter>::value, "");
+
+TEST_CASE("async_rate_limiter ctor", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	async_rate_limiter rl{ctx.get_executor(), 100, 5};
+	CHECK(rl.rate() == 100);
+	CHECK(rl.burst() == 5);
+	CHECK(rl.tokens() == 5);
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_rate_limiter as default on detached", "[async_rate_limiter]")
+{
+	using limiter_d = boost::asio::detached_t::as_default_on_t<
+		coma::async_rate_limiter<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	limiter_d rl{ctx.get_executor(), 1, 1};
+	rl.async_acquire();
+	rl.async_acquire(1);
+}
+#endif
+
+TEST_CASE("async_rate_limiter burst immediate", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	// slow refill, only the burst is available
+	async_rate_limiter rl{ctx.get_executor(), 0.001, 3};
+
+	int done = 0;
+	rl.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	rl.async_acquire(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	CHECK(done == 0);
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(!rl.try_acquire());
+}
+
+TEST_CASE("async_rate_limiter try_acquire", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	async_rate_limiter rl{ctx.get_executor(), 0.001, 2};
+
+	CHECK(rl.try_acquire());
+	CHECK(!rl.try_acquire(2));
+	CHECK(rl.try_acquire());
+	CHECK(!rl.try_acquire());
+	CHECK(rl.stats().acquires == 2);
+}
+
+TEST_CASE("async_rate_limiter waits for refill", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	// one token every 20ms
+	async_rate_limiter rl{ctx.get_executor(), 50, 1};
+
+	const auto start = clock_type::now();
+	std::vector<clock_type::duration> times;
+	for (int i = 0; i < 4; ++i)
+	{
+		rl.async_acquire([&](boost::system::error_code ec) {
+			CHECK(!ec);
+			times.push_back(clock_type::now() - start);
+		});
+	}
+	ctx.poll();
+	CHECK(times.size() == 1);
+	CHECK(rl.stats().waiters == 3);
+	// later acquires queue behind the waiters
+	CHECK(!rl.try_acquire());
+
+	ctx.run();
+	REQUIRE(times.size() == 4);
+	CHECK(times[3] >= milliseconds{60});
+	CHECK(rl.stats().waiters == 0);
+	CHECK(rl.stats().acquires == 4);
+}
+
+TEST_CASE("async_rate_limiter fifo acquire n", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	async_rate_limiter rl{ctx.get_executor(), 200, 3};
+	REQUIRE(rl.try_acquire(3));
+
+	std::vector<int> order;
+	rl.async_acquire(3, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		order.push_back(1);
+	});
+	rl.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		order.push_back(2);
+	});
+	ctx.run();
+	CHECK(order == std::vector<int>{1, 2});
+}
+
+TEST_CASE("async_rate_limiter idle has no pending timer", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	async_rate_limiter rl{ctx.get_executor(), 1000, 1};
+	REQUIRE(rl.try_acquire());
+	rl.async_acquire([](boost::system::error_code ec) { CHECK(!ec); });
+	ctx.run();
+	// run returned, nothing is ticking
+	ctx.restart();
+	CHECK(ctx.poll() == 0);
+}
+
+TEST_CASE("async_rate_limiter destroy with waiters", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_rate_limiter rl{ctx.get_executor(), 1, 1};
+		REQUIRE(rl.try_acquire());
+		rl.async_acquire([&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 1);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("async_rate_limiter coro", "[async_rate_limiter]")
+{
+	boost::asio::io_context ctx;
+	async_rate_limiter rl{ctx.get_executor(), 500, 2};
+
+	int done = 0;
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			for (int i = 0; i < 6; ++i)
+			{
+				co_await rl.async_acquire(use_awaitable);
+				++done;
+			}
+		},
+		boost::asio::detached);
+	ctx.run();
+	CHECK(done == 6);
+}
+
+#endif
@@ -1,7 +1,10 @@
 #include <coma/async_semaphore.hpp>
 #include <test_util.hpp>
+#include <boost/asio/bind_executor.hpp>
 #include <boost/asio/detached.hpp>
 
+#include <vector>
+
 #ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
 using async_semaphore = coma::async_semaphore<>;
 #else
@@ -177,6 +180,443 @@ TEST_CASE("async_semaphore async_acquire_n", "[async_semaphore]")
 	CHECK(done == 1);
 }
 
+TEST_CASE("async_semaphore stats", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+	CHECK(sem.try_acquire());
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code) { ++done; });
+	sem.async_acquire_n(2, [&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	ctx.restart();
+	auto s = sem.stats();
+	CHECK(s.waiters == 2);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 1);
+	// wakes both, acquire_n does not get enough permits
+	sem.release(2);
+	ctx.poll();
+	ctx.restart();
+	s = sem.stats();
+	CHECK(done == 1);
+	CHECK(s.waiters == 1);
+	CHECK(s.acquires == 2);
+	CHECK(s.wakeups == 2);
+	CHECK(s.spurious_wakeups == 1);
+	sem.release(2);
+	ctx.poll();
+	s = sem.stats();
+	CHECK(done == 2);
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 3);
+	CHECK(s.timeouts == 0);
+	CHECK(s.cancellations == 0);
+}
+
+TEST_CASE("async_semaphore stats uncontended", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 5};
+	int done = 0;
+	for (int i = 0; i < 5; ++i)
+		sem.async_acquire([&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	const auto s = sem.stats();
+	CHECK(done == 5);
+	CHECK(s.waiters == 0);
+	CHECK(s.peak_waiters == 0);
+	CHECK(s.acquires == 5);
+	CHECK(s.wakeups == 0);
+}
+
+TEST_CASE("async_semaphore without stats", "[async_semaphore]")
+{
+	using executor = boost::asio::io_context::executor_type;
+	using uncounted =
+		coma::async_semaphore<executor, coma::null_wait_observer, coma::wait_stats_mode::none>;
+	static_assert(sizeof(uncounted) < sizeof(coma::async_semaphore<executor>), "");
+
+	boost::asio::io_context ctx;
+	uncounted sem{ctx.get_executor(), 0};
+	sem.set_max_waiters(1);
+	int done = 0;
+	boost::system::error_code rejected;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem.async_acquire([&](boost::system::error_code ec) { rejected = ec; });
+	ctx.poll();
+	ctx.restart();
+	CHECK(rejected == coma::error::queue_full);
+	sem.release();
+	ctx.poll();
+	CHECK(done == 1);
+	const auto s = sem.stats();
+	CHECK(s.acquires == 0);
+	CHECK(s.rejections == 0);
+	CHECK(s.peak_waiters == 0);
+}
+
+TEST_CASE("async_semaphore max waiters", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+	sem.set_max_waiters(2);
+	CHECK(sem.max_waiters() == 2);
+
+	int acquired = 0;
+	int rejected = 0;
+	auto handler = [&](boost::system::error_code ec) {
+		if (ec)
+		{
+			CHECK(ec == coma::error::queue_full);
+			++rejected;
+		}
+		else
+			++acquired;
+	};
+	// a permit is available, not rejected
+	sem.async_acquire(handler);
+	ctx.poll();
+	ctx.restart();
+	CHECK(acquired == 1);
+
+	sem.async_acquire(handler);
+	sem.async_acquire_n(2, handler);
+	sem.async_acquire(handler);
+	sem.async_acquire_n(3, handler);
+	ctx.poll();
+	CHECK(acquired == 1);
+	CHECK(rejected == 2);
+	CHECK(sem.stats().waiters == 2);
+	CHECK(sem.stats().rejections == 2);
+
+	sem.release(3);
+	ctx.poll();
+	CHECK(acquired == 3);
+	CHECK(sem.stats().waiters == 0);
+
+	sem.release();
+	ctx.restart();
+	sem.async_acquire(handler);
+	ctx.run();
+	CHECK(acquired == 4);
+	CHECK(rejected == 2);
+}
+
+TEST_CASE("async_semaphore max waiters before poll", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+	sem.set_max_waiters(1);
+
+	int acquired = 0;
+	int rejected = 0;
+	auto handler = [&](boost::system::error_code ec) {
+		if (ec)
+			++rejected;
+		else
+			++acquired;
+	};
+	// none of them took a permit or parked yet when the next one starts
+	sem.async_acquire(handler);
+	sem.async_acquire(handler);
+	sem.async_acquire(handler);
+	sem.async_acquire_up_to(2, [&](boost::system::error_code ec, std::ptrdiff_t) {
+		handler(ec);
+	});
+	ctx.poll();
+	ctx.restart();
+	CHECK(acquired == 1);
+	CHECK(rejected == 2);
+	CHECK(sem.stats().waiters == 1);
+	CHECK(sem.stats().rejections == 2);
+
+	sem.release();
+	ctx.poll();
+	CHECK(acquired == 2);
+	CHECK(sem.stats().waiters == 0);
+}
+
+TEST_CASE("async_semaphore max waiters zero", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	sem.set_max_waiters(0);
+
+	bool rejected = false;
+	sem.async_acquire([&](boost::system::error_code ec) { rejected = ec == coma::error::queue_full; });
+	CHECK(!rejected);
+	ctx.run();
+	CHECK(rejected);
+}
+
+TEST_CASE("async_semaphore set_capacity shrink with debt", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 4};
+	CHECK(sem.capacity() == 4);
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(sem.try_acquire());
+	REQUIRE(sem.try_acquire());
+	sem.set_capacity(1);
+	CHECK(sem.capacity() == 1);
+	CHECK(sem.available() == 0);
+	CHECK(sem.debt() == 2);
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	// releases pay the debt first
+	sem.release();
+	sem.release();
+	ctx.poll();
+	CHECK(done == 0);
+	CHECK(sem.debt() == 0);
+	sem.release();
+	ctx.poll();
+	CHECK(done == 1);
+	CHECK(sem.available() == 0);
+
+	// release(n) pays debt and returns the remainder
+	sem.set_capacity(0);
+	CHECK(sem.debt() == 1);
+	sem.set_capacity(2);
+	CHECK(sem.debt() == 0);
+	CHECK(sem.available() == 1);
+	sem.set_capacity(0);
+	CHECK(sem.available() == 0);
+	CHECK(sem.debt() == 1);
+	sem.release(3);
+	CHECK(sem.debt() == 0);
+	CHECK(sem.available() == 2);
+}
+
+TEST_CASE("async_semaphore set_capacity grow wakes exactly", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	for (int i = 0; i < 5; ++i)
+	{
+		sem.async_acquire([&](boost::system::error_code ec) {
+			CHECK(!ec);
+			++done;
+		});
+	}
+	ctx.poll();
+	sem.set_capacity(2);
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(sem.stats().spurious_wakeups == 0);
+	CHECK(sem.stats().waiters == 3);
+
+	sem.set_capacity(10);
+	ctx.poll();
+	CHECK(done == 5);
+	CHECK(sem.available() == 5);
+	CHECK(sem.stats().spurious_wakeups == 0);
+}
+
+TEST_CASE("async_semaphore set_capacity after release growth", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+
+	// releasing more than acquired adds permits
+	REQUIRE(sem.try_acquire());
+	sem.release(3);
+	CHECK(sem.capacity() == 4);
+	CHECK(sem.available() == 4);
+	sem.set_capacity(2);
+	CHECK(sem.available() == 2);
+	CHECK(sem.debt() == 0);
+
+	REQUIRE(sem.try_acquire_n(2));
+	sem.set_capacity(1);
+	CHECK(sem.debt() == 1);
+	// pays the debt, returns one permit and adds one
+	sem.release(3);
+	CHECK(sem.capacity() == 2);
+	CHECK(sem.available() == 2);
+	CHECK(sem.debt() == 0);
+}
+
+TEST_CASE("async_semaphore set_capacity grow with acquire_n waiting", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	std::vector<int> done;
+	sem.async_acquire_n(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		done.push_back(2);
+	});
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		done.push_back(1);
+	});
+	ctx.poll();
+	ctx.restart();
+	// not enough for the first waiter, the one behind it is served
+	sem.set_capacity(1);
+	ctx.poll();
+	ctx.restart();
+	CHECK(done == std::vector<int>{1});
+	sem.set_capacity(3);
+	ctx.poll();
+	CHECK(done == (std::vector<int>{1, 2}));
+	CHECK(sem.available() == 0);
+
+	sem.release(3);
+	CHECK(sem.capacity() == 3);
+	sem.release();
+	CHECK(sem.capacity() == 4);
+	CHECK(sem.available() == 4);
+}
+
+TEST_CASE("async_semaphore try_acquire_up_to", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 3};
+
+	CHECK(sem.try_acquire_up_to(2) == 2);
+	CHECK(sem.try_acquire_up_to(5) == 1);
+	CHECK(sem.try_acquire_up_to(5) == 0);
+	CHECK(sem.available() == 0);
+	CHECK(sem.stats().acquires == 2);
+	CHECK(sem.try_acquire_n(0));
+	sem.release(3);
+	CHECK(!sem.try_acquire_n(4));
+	CHECK(sem.try_acquire_n(3));
+}
+
+TEST_CASE("async_semaphore async_acquire_up_to", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+
+	std::vector<std::ptrdiff_t> granted;
+	auto handler = [&](boost::system::error_code ec, std::ptrdiff_t n) {
+		CHECK(!ec);
+		granted.push_back(n);
+	};
+	// takes what is available without waiting for n
+	sem.async_acquire_up_to(5, handler);
+	ctx.poll();
+	REQUIRE(granted.size() == 1);
+	CHECK(granted[0] == 2);
+	CHECK(sem.available() == 0);
+
+	// waits for at least one
+	sem.async_acquire_up_to(4, handler);
+	sem.async_acquire_up_to(4, handler);
+	ctx.restart();
+	ctx.poll();
+	CHECK(granted.size() == 1);
+	sem.release(3);
+	ctx.poll();
+	REQUIRE(granted.size() == 2);
+	CHECK(granted[1] == 3);
+	CHECK(sem.stats().waiters == 1);
+	sem.release();
+	ctx.poll();
+	REQUIRE(granted.size() == 3);
+	CHECK(granted[2] == 1);
+	CHECK(sem.stats().waiters == 0);
+	CHECK(sem.stats().acquires == 3);
+}
+
+TEST_CASE("async_semaphore async_acquire_up_to max waiters", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	sem.set_max_waiters(0);
+
+	boost::system::error_code result;
+	std::ptrdiff_t granted = -1;
+	sem.async_acquire_up_to(2, [&](boost::system::error_code ec, std::ptrdiff_t n) {
+		result = ec;
+		granted = n;
+	});
+	ctx.run();
+	CHECK(result == coma::error::queue_full);
+	CHECK(granted == 0);
+}
+
+TEST_CASE("async_semaphore async_acquire_up_to max waiters counts its demand", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+	sem.set_max_waiters(1);
+
+	std::vector<int> rejected;
+	sem.async_acquire_up_to(2, [&](boost::system::error_code ec, std::ptrdiff_t n) {
+		CHECK(!ec);
+		CHECK(n == 2);
+	});
+	// both wait once the first took the 2 permits
+	sem.async_acquire([&](boost::system::error_code ec) {
+		if (ec)
+			rejected.push_back(1);
+	});
+	sem.async_acquire([&](boost::system::error_code ec) {
+		if (ec)
+			rejected.push_back(2);
+	});
+	ctx.poll();
+	CHECK(rejected == std::vector<int>{2});
+	CHECK(sem.stats().waiters == 1);
+}
+
+TEST_CASE("async_semaphore aborted acquire does not reduce admission", "[async_semaphore]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+	sem.set_max_waiters(2);
+
+	{
+		// the checks run on the handler's executor, destroyed before they run
+		boost::asio::io_context other;
+		bool called = false;
+		sem.async_acquire_n(
+			2, boost::asio::bind_executor(other, [&](boost::system::error_code) { called = true; }));
+		sem.async_acquire_up_to(
+			2, boost::asio::bind_executor(other, [&](boost::system::error_code, std::ptrdiff_t) {
+				called = true;
+			}));
+		CHECK(!called);
+	}
+	// releasing their work on ctx stopped it
+	ctx.restart();
+	sem.set_max_waiters(1);
+
+	int acquired = 0;
+	int rejected = 0;
+	auto handler = [&](boost::system::error_code ec) {
+		if (ec)
+			++rejected;
+		else
+			++acquired;
+	};
+	sem.async_acquire(handler);
+	ctx.poll();
+	CHECK(rejected == 0);
+	CHECK(sem.stats().waiters == 1);
+	sem.release();
+	ctx.poll();
+	CHECK(acquired == 1);
+	CHECK(rejected == 0);
+}
+
 #if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
 
 using boost::asio::awaitable;
@@ -0,0 +1,366 @@
+#include <coma/async_semaphore_compact.hpp>
+#include <test_util.hpp>
+#include <boost/asio/detached.hpp>
+
+#ifdef COMA_HAS_DEFAULT_IO_EXECUTOR
+using async_semaphore = coma::async_semaphore_compact<>;
+#else
+using async_semaphore = coma::async_semaphore_compact<boost::asio::io_context::executor_type>;
+#endif
+
+static_assert(!std::is_copy_constructible<async_semaphore>::value, "");
+static_assert(!std::is_move_constructible<async_semaphore>::value, "");
+static_assert(!std::is_copy_assignable<async_semaphore>::value, "");
+static_assert(!std::is_move_assignable<async_semaphore>::value, "");
+
+TEST_CASE("async_semaphore_compact ctor", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+}
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_semaphore_compact as default on detached", "[async_semaphore_compact]")
+{
+    using semaphore_d = boost::asio::detached_t::as_default_on_t<coma::async_semaphore_compact<boost::asio::io_context::executor_type>>;
+	boost::asio::io_context ctx;
+	semaphore_d sem{ctx.get_executor(), 0};
+    sem.async_acquire();
+}
+#endif
+
+TEST_CASE("async_semaphore_compact try_acquire", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release();
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+	sem.release(2);
+	REQUIRE(sem.try_acquire());
+	REQUIRE(sem.try_acquire());
+	REQUIRE(!sem.try_acquire());
+
+	sem.release();
+	{
+		REQUIRE(sem.try_acquire());
+		REQUIRE(!sem.try_acquire());
+		coma::acquire_guard<async_semaphore> g{sem, coma::adapt_acquire};
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+	sem.release();
+	{
+		coma::unique_acquire_guard<async_semaphore> g{sem, coma::try_to_acquire};
+		CHECK(g);
+		REQUIRE(!sem.try_acquire());
+	}
+	REQUIRE(sem.try_acquire());
+}
+
+TEST_CASE("async_semaphore_compact async_acquire waiting", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact async_acquire immediate", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact async_acquire many", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.poll();
+	CHECK(done == 1);
+
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_semaphore_compact async_acquire many release 2", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { sem.release(2); });
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("async_semaphore_compact async_acquire_n immediate", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 2};
+
+	int done = 0;
+	sem.async_acquire_n(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact async_acquire_n", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire_n(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::post(ctx, [&] { sem.release(); });
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact fifo acquire_n", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+
+	int done = 0;
+	sem.async_acquire_n(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 0);
+		done = 1;
+	});
+	// queued behind the first waiter even though a permit is available
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		CHECK(done == 1);
+		done = 2;
+	});
+	CHECK(!sem.try_acquire());
+	ctx.poll();
+	CHECK(done == 0);
+
+	sem.release(2);
+	ctx.run();
+	CHECK(done == 2);
+	CHECK(!sem.try_acquire());
+}
+
+TEST_CASE("async_semaphore_compact release hands off permit", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	sem.release();
+	// the permit belongs to the waiter before its handler runs
+	CHECK(!sem.try_acquire());
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact destroy with waiters", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	int done = 0;
+	{
+		async_semaphore sem{ctx.get_executor(), 0};
+		sem.async_acquire([&](boost::system::error_code ec) {
+			CHECK(ec == boost::asio::error::operation_aborted);
+			++done;
+		});
+		ctx.poll();
+	}
+	ctx.run();
+	CHECK(done == 1);
+}
+
+TEST_CASE("async_semaphore_compact stats", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 1};
+	CHECK(sem.try_acquire());
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code) { ++done; });
+	sem.async_acquire_n(2, [&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	ctx.restart();
+	auto s = sem.stats();
+	CHECK(s.waiters == 2);
+	CHECK(s.peak_waiters == 2);
+	CHECK(s.acquires == 1);
+	// permits are handed off, no spurious wakeups
+	sem.release(2);
+	ctx.poll();
+	ctx.restart();
+	s = sem.stats();
+	CHECK(done == 1);
+	CHECK(s.waiters == 1);
+	CHECK(s.acquires == 2);
+	CHECK(s.wakeups == 1);
+	sem.release(1);
+	ctx.poll();
+	s = sem.stats();
+	CHECK(done == 2);
+	CHECK(s.waiters == 0);
+	CHECK(s.acquires == 3);
+	CHECK(s.wakeups == 2);
+	CHECK(s.spurious_wakeups == 0);
+}
+
+TEST_CASE("async_semaphore_compact without stats", "[async_semaphore_compact]")
+{
+	using executor = boost::asio::io_context::executor_type;
+	using uncounted = coma::async_semaphore_compact<executor, coma::wait_stats_mode::none>;
+	static_assert(sizeof(uncounted) < sizeof(coma::async_semaphore_compact<executor>), "");
+
+	boost::asio::io_context ctx;
+	uncounted sem{ctx.get_executor(), 0};
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	ctx.restart();
+	CHECK(sem.stats().waiters == 0);
+	sem.release();
+	ctx.poll();
+	CHECK(done == 1);
+	CHECK(sem.stats().acquires == 0);
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+#ifdef COMA_HAS_AS_DEFAULT_ON
+TEST_CASE("async_semaphore_compact coro as default on", "[async_semaphore_compact]")
+{
+    using semaphore_coro = boost::asio::use_awaitable_t<>::as_default_on_t<coma::async_semaphore_compact<boost::asio::io_context::executor_type>>;
+
+	boost::asio::io_context ctx;
+	semaphore_coro sem{ctx.get_executor(), 1};
+
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await sem.async_acquire();
+		},
+		boost::asio::detached);
+	ctx.run();
+}
+#endif
+
+TEST_CASE("async_semaphore_compact coro async_acquire many", "[async_semaphore_compact]")
+{
+	boost::asio::io_context ctx;
+	async_semaphore sem{ctx.get_executor(), 0};
+
+	int done = 0;
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await sem.async_acquire(use_awaitable);
+			++done;
+		},
+		boost::asio::detached);
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await sem.async_acquire(use_awaitable);
+			++done;
+		},
+		boost::asio::detached);
+
+	ctx.poll();
+	CHECK(done == 0);
+
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			sem.release();
+			co_return;
+		},
+		boost::asio::detached);
+
+	ctx.poll();
+	CHECK(done == 1);
+
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			sem.release();
+			co_return;
+		},
+		boost::asio::detached);
+
+	ctx.run();
+	CHECK(done == 2);
+}
+
+#endif
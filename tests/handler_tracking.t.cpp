@@ -0,0 +1,99 @@
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_semaphore.hpp>
+#include <test_util.hpp>
+
+#include <cstdio>
+#include <string>
+
+#if defined(__unix__)
+#include <unistd.h>
+
+using executor = boost::asio::io_context::executor_type;
+
+namespace {
+
+// captures what asio's handler tracking writes to stderr
+class stderr_capture
+{
+	std::FILE* m_file;
+	int m_saved;
+
+public:
+	stderr_capture()
+		: m_file{std::tmpfile()}
+		, m_saved{::dup(2)}
+	{
+		::dup2(::fileno(m_file), 2);
+	}
+	~stderr_capture()
+	{
+		::dup2(m_saved, 2);
+		::close(m_saved);
+		std::fclose(m_file);
+	}
+
+	std::string str()
+	{
+		std::string r;
+		std::rewind(m_file);
+		char buf[512];
+		std::size_t n;
+		while ((n = std::fread(buf, 1, sizeof(buf), m_file)) > 0)
+			r.append(buf, n);
+		return r;
+	}
+};
+
+} // namespace
+
+TEST_CASE("handler tracking async_semaphore", "[handler_tracking]")
+{
+	std::string out;
+	{
+		stderr_capture capture;
+		boost::asio::io_context ctx;
+		coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+		sem.async_acquire([](boost::system::error_code) {});
+		ctx.poll();
+		ctx.restart();
+		sem.release();
+		ctx.poll();
+		out = capture.str();
+	}
+	// creation of the wait, with the initiating function as location
+	CHECK(out.find("|async_semaphore@") != std::string::npos);
+	CHECK(out.find(".wait") != std::string::npos);
+	CHECK(out.find("coma::async_semaphore::async_acquire") != std::string::npos);
+}
+
+TEST_CASE("handler tracking uncontended acquire", "[handler_tracking]")
+{
+	std::string out;
+	{
+		stderr_capture capture;
+		boost::asio::io_context ctx;
+		coma::async_semaphore<executor> sem{ctx.get_executor(), 1};
+		sem.async_acquire([](boost::system::error_code) {});
+		ctx.poll();
+		out = capture.str();
+	}
+	CHECK(out.find("|async_semaphore@") == std::string::npos);
+}
+
+TEST_CASE("handler tracking async_cond_var_timed", "[handler_tracking]")
+{
+	std::string out;
+	{
+		stderr_capture capture;
+		boost::asio::io_context ctx;
+		coma::async_cond_var_timed<executor> cv{ctx.get_executor()};
+		cv.async_wait_for(std::chrono::milliseconds{1},
+						  [](boost::system::error_code, coma::cv_status) {});
+		ctx.run();
+		out = capture.str();
+	}
+	CHECK(out.find("|async_cond_var_timed@") != std::string::npos);
+	CHECK(out.find("coma::async_cond_var_timed::async_wait_until") != std::string::npos);
+}
+
+#endif
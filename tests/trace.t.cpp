@@ -0,0 +1,140 @@
+#include <coma/async_cond_var.hpp>
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_semaphore.hpp>
+#include <coma/trace.hpp>
+#include <test_util.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <sstream>
+#include <string>
+
+using executor = boost::asio::io_context::executor_type;
+
+TEST_CASE("trace_buffer ring", "[trace]")
+{
+	coma::trace_buffer buf{3};
+	coma::trace_span s{};
+	for (int i = 0; i < 5; ++i)
+	{
+		s.object = reinterpret_cast<const void*>(static_cast<std::uintptr_t>(i + 1));
+		buf.record(s);
+	}
+	const auto spans = buf.spans();
+	REQUIRE(spans.size() == 3);
+	CHECK(spans[0].object == reinterpret_cast<const void*>(std::uintptr_t{3}));
+	CHECK(spans[2].object == reinterpret_cast<const void*>(std::uintptr_t{5}));
+	CHECK(buf.total() == 5);
+	buf.clear();
+	CHECK(buf.spans().empty());
+}
+
+TEST_CASE("trace async_semaphore spans", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+	sem.set_trace_name("pool");
+	sem.async_acquire([](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	CHECK(buf.spans().empty());
+	sem.release();
+	ctx.poll();
+	const auto spans = buf.spans();
+	REQUIRE(spans.size() == 1);
+	CHECK(std::string{spans[0].name} == "pool");
+	CHECK(spans[0].context == reinterpret_cast<std::uintptr_t>(
+								  static_cast<boost::asio::execution_context*>(&ctx)));
+	CHECK(spans[0].begin <= spans[0].end);
+	CHECK(!spans[0].cancelled);
+}
+
+TEST_CASE("trace waiter executor", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	boost::asio::io_context other;
+	coma::async_cond_var<executor> cv{ctx.get_executor()};
+	cv.async_wait(boost::asio::bind_executor(other.get_executor(),
+											 [](boost::system::error_code) {}));
+	ctx.poll();
+	ctx.restart();
+	cv.notify_one();
+	ctx.poll();
+	other.poll();
+	const auto spans = buf.spans();
+	REQUIRE(spans.size() == 1);
+	CHECK(std::string{spans[0].name} == "async_cond_var");
+	CHECK(spans[0].context == reinterpret_cast<std::uintptr_t>(
+								  static_cast<boost::asio::execution_context*>(&other)));
+}
+
+TEST_CASE("trace async_cond_var_timed cancelled", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	coma::async_cond_var_timed<executor> cv{ctx.get_executor()};
+	cv.async_wait([](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	cv.stop();
+	ctx.poll();
+	const auto spans = buf.spans();
+	REQUIRE(spans.size() == 1);
+	CHECK(spans[0].cancelled);
+}
+
+TEST_CASE("trace uncontended acquire", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 1};
+	sem.async_acquire([](boost::system::error_code) {});
+	ctx.poll();
+	CHECK(buf.spans().empty());
+}
+
+TEST_CASE("trace predicate waiter executor", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	boost::asio::io_context other;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+	sem.async_acquire(boost::asio::bind_executor(other.get_executor(),
+												 [](boost::system::error_code) {}));
+	other.poll();
+	other.restart();
+	sem.release();
+	ctx.poll();
+	other.poll();
+	const auto spans = buf.spans();
+	REQUIRE(spans.size() == 1);
+	CHECK(spans[0].context == reinterpret_cast<std::uintptr_t>(
+								  static_cast<boost::asio::execution_context*>(&other)));
+}
+
+TEST_CASE("trace chrome json", "[trace]")
+{
+	auto& buf = coma::global_trace_buffer();
+	buf.clear();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+	sem.set_trace_name("db \"main\"\\\n");
+	sem.async_acquire([](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	sem.release();
+	ctx.poll();
+	std::ostringstream os;
+	buf.write_chrome_trace(os);
+	const auto json = os.str();
+	CHECK(json.find("\"traceEvents\"") != std::string::npos);
+	CHECK(json.find("\"name\":\"db \\\"main\\\"\\\\\\u000a\"") != std::string::npos);
+	CHECK(json.find("\"ph\":\"X\"") != std::string::npos);
+	CHECK(json.find("\"thread_name\"") != std::string::npos);
+}
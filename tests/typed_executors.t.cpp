@@ -0,0 +1,62 @@
+#include <coma/typed_executors.hpp>
+#include <test_util.hpp>
+
+static_assert(std::is_same<coma::io::async_semaphore::executor_type,
+						   boost::asio::io_context::executor_type>::value,
+			  "");
+static_assert(std::is_same<coma::io_strand::async_cond_var::executor_type,
+						   boost::asio::strand<boost::asio::io_context::executor_type>>::value,
+			  "");
+
+TEST_CASE("typed_executors io semaphore", "[typed_executors]")
+{
+	boost::asio::io_context ctx;
+	coma::io::async_semaphore sem{ctx.get_executor(), 0};
+	coma::io::async_semaphore_compact sem_c{ctx.get_executor(), 0};
+
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem_c.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	CHECK(done == 0);
+
+	sem.release();
+	sem_c.release();
+	ctx.run();
+	CHECK(done == 2);
+}
+
+TEST_CASE("typed_executors strand cond var", "[typed_executors]")
+{
+	boost::asio::io_context ctx;
+	coma::io_strand::executor_type strand{ctx.get_executor()};
+	coma::io_strand::async_cond_var cv{strand};
+	coma::io_strand::async_cond_var_compact cv_c{strand};
+	coma::io_strand::async_cond_var_timed cv_t{strand};
+
+	int done = 0;
+	bool ready = false;
+	auto handler = [&](boost::system::error_code ec) {
+		CHECK(strand.running_in_this_thread());
+		CHECK(!ec);
+		++done;
+	};
+	cv.async_wait([&] { return ready; }, handler);
+	cv_c.async_wait([&] { return ready; }, handler);
+	cv_t.async_wait([&] { return ready; }, handler);
+	ctx.poll();
+	CHECK(done == 0);
+
+	ready = true;
+	cv.notify_all();
+	cv_c.notify_all();
+	cv_t.notify_all();
+	ctx.run();
+	CHECK(done == 3);
+}
@@ -0,0 +1,226 @@
+#include <coma/async_cond_var.hpp>
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_semaphore.hpp>
+#include <coma/wait_observer.hpp>
+#include <test_util.hpp>
+
+#include <algorithm>
+#include <string>
+
+using executor = boost::asio::io_context::executor_type;
+
+static_assert(sizeof(coma::async_semaphore<executor>) ==
+				  sizeof(coma::async_semaphore<executor, coma::null_wait_observer>),
+			  "");
+static_assert(std::is_same<coma::async_semaphore<executor, coma::histogram_wait_observer>::
+							   rebind_executor<executor>::other,
+						   coma::async_semaphore<executor, coma::histogram_wait_observer>>::value,
+			  "");
+
+namespace {
+
+// records the order of the events
+struct event_observer
+{
+	using clock = std::chrono::steady_clock;
+	using time_point = clock::time_point;
+
+	std::string events;
+	time_point last{};
+
+	void on_park(time_point t) noexcept { add('p', t); }
+	void on_wake(time_point t) noexcept { add('w', t); }
+	void on_spurious_wake(time_point t) noexcept { add('s', t); }
+	void on_timeout(time_point t) noexcept { add('t', t); }
+	void on_complete(time_point parked, time_point t) noexcept
+	{
+		CHECK(parked <= t);
+		add('c', t);
+	}
+
+	void add(char e, time_point t)
+	{
+		CHECK(last <= t);
+		last = t;
+		events += e;
+	}
+};
+
+} // namespace
+
+TEST_CASE("latency_histogram empty", "[wait_observer]")
+{
+	coma::latency_histogram h;
+	CHECK(h.count() == 0);
+	CHECK(h.percentile(50) == 0);
+	CHECK(h.mean() == 0);
+}
+
+TEST_CASE("latency_histogram exact small values", "[wait_observer]")
+{
+	coma::latency_histogram h;
+	for (std::uint64_t v = 1; v <= 10; ++v)
+		h.record(v);
+	CHECK(h.count() == 10);
+	CHECK(h.min() == 1);
+	CHECK(h.max() == 10);
+	CHECK(h.mean() == Approx(5.5));
+	CHECK(h.percentile(50) == 5);
+	CHECK(h.percentile(100) == 10);
+}
+
+TEST_CASE("latency_histogram relative error", "[wait_observer]")
+{
+	coma::latency_histogram h;
+	const std::uint64_t values[] = {100, 1000, 123456, 987654321, std::uint64_t{1} << 62};
+	for (auto v : values)
+	{
+		h.reset();
+		h.record(v);
+		h.record(~std::uint64_t{0});
+		const auto p = h.percentile(50);
+		CHECK(p >= v);
+		CHECK(static_cast<double>(p - v) <= static_cast<double>(v) / coma::latency_histogram::sub_count);
+	}
+	CHECK(h.percentile(100) == ~std::uint64_t{0});
+}
+
+TEST_CASE("latency_histogram merge", "[wait_observer]")
+{
+	coma::latency_histogram a;
+	coma::latency_histogram b;
+	a.record(10);
+	b.record(5);
+	b.record(20);
+	a.merge(b);
+	CHECK(a.count() == 3);
+	CHECK(a.min() == 5);
+	CHECK(a.max() == 20);
+}
+
+TEST_CASE("async_semaphore observer events", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor, event_observer> sem{ctx.get_executor(), 0};
+	int done = 0;
+	sem.async_acquire([&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	sem.async_acquire_n(2, [&](boost::system::error_code ec) {
+		CHECK(!ec);
+		++done;
+	});
+	ctx.poll();
+	ctx.restart();
+	CHECK(sem.observer().events == "pp");
+	// wakes both, acquire_n goes back to sleep
+	sem.release(2);
+	ctx.poll();
+	ctx.restart();
+	CHECK(done == 1);
+	CHECK(sem.observer().events == "ppwcws");
+	sem.release(2);
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(sem.observer().events == "ppwcwswc");
+}
+
+TEST_CASE("async_semaphore observer uncontended", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor, coma::histogram_wait_observer> sem{ctx.get_executor(), 3};
+	int done = 0;
+	for (int i = 0; i < 3; ++i)
+		sem.async_acquire([&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	CHECK(done == 3);
+	const auto& obs = sem.observer();
+	CHECK(obs.depth() == 0);
+	CHECK(obs.queue_depth().count() == 0);
+	CHECK(obs.wait_latency().count() == 0);
+}
+
+TEST_CASE("async_cond_var observer events", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_cond_var<executor, event_observer> cv{ctx.get_executor()};
+	bool ready = false;
+	int done = 0;
+	cv.async_wait([&](boost::system::error_code) { ++done; });
+	cv.async_wait([&] { return ready; }, [&](boost::system::error_code) { ++done; });
+	ctx.poll();
+	ctx.restart();
+	cv.notify_all();
+	ctx.poll();
+	ctx.restart();
+	CHECK(done == 1);
+	ready = true;
+	cv.notify_all();
+	ctx.poll();
+	CHECK(done == 2);
+	CHECK(cv.observer().events == "ppwcwswc");
+}
+
+TEST_CASE("async_cond_var_timed observer timeout", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_cond_var_timed<executor, event_observer> cv{ctx.get_executor()};
+	int done = 0;
+	cv.async_wait_for(std::chrono::milliseconds{1},
+					  [&](boost::system::error_code ec, coma::cv_status s) {
+						  CHECK(!ec);
+						  CHECK(s == coma::cv_status::timeout);
+						  ++done;
+					  });
+	cv.async_wait_for(std::chrono::milliseconds{1}, [] { return false; },
+					  [&](boost::system::error_code ec, bool r) {
+						  CHECK(!ec);
+						  CHECK(!r);
+						  ++done;
+					  });
+	ctx.run();
+	CHECK(done == 2);
+	const auto& ev = cv.observer().events;
+	CHECK(std::count(ev.begin(), ev.end(), 'p') == 2);
+	CHECK(std::count(ev.begin(), ev.end(), 't') == 2);
+	CHECK(std::count(ev.begin(), ev.end(), 'c') == 2);
+}
+
+TEST_CASE("async_cond_var_timed observer without stats", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_cond_var_timed<executor, event_observer, coma::wait_stats_mode::none> cv{
+		ctx.get_executor()};
+	int done = 0;
+	cv.async_wait_for(std::chrono::milliseconds{1},
+					  [&](boost::system::error_code ec, coma::cv_status s) {
+						  CHECK(!ec);
+						  CHECK(s == coma::cv_status::timeout);
+						  ++done;
+					  });
+	ctx.run();
+	CHECK(done == 1);
+	// the observer still gets the events
+	CHECK(cv.observer().events == "ptc");
+	CHECK(cv.stats().timeouts == 0);
+}
+
+TEST_CASE("histogram_wait_observer", "[wait_observer]")
+{
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor, coma::histogram_wait_observer> sem{ctx.get_executor(), 0};
+	for (int i = 0; i < 3; ++i)
+		sem.async_acquire([](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	CHECK(sem.observer().depth() == 3);
+	CHECK(sem.observer().queue_depth().max() == 3);
+	sem.release(3);
+	ctx.poll();
+	const auto& obs = sem.observer();
+	CHECK(obs.depth() == 0);
+	CHECK(obs.wait_latency().count() == 3);
+	CHECK(obs.wakeups() == 3);
+	CHECK(obs.spurious_wakeups() == 0);
+}
@@ -0,0 +1,195 @@
+#include <coma/async_cond_var.hpp>
+#include <coma/async_cond_var_timed.hpp>
+#include <coma/async_semaphore.hpp>
+#include <coma/waiter_registry.hpp>
+#include <test_util.hpp>
+
+#include <sstream>
+#include <string>
+
+using executor = boost::asio::io_context::executor_type;
+
+TEST_CASE("waiter_registry tags and positions", "[waiter_registry]")
+{
+	auto& registry = coma::waiter_registry::global();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+	sem.set_trace_name("pool");
+	sem.async_acquire(coma::tag_wait("first", [](boost::system::error_code) {}));
+	sem.async_acquire(coma::tag_wait("second", [](boost::system::error_code) {}));
+	ctx.poll();
+	ctx.restart();
+	auto ws = registry.waiters();
+	REQUIRE(ws.size() == 2);
+	CHECK(std::string{ws[0].name} == "pool");
+	CHECK(std::string{ws[0].tag} == "first");
+	CHECK(ws[0].position == 0);
+	CHECK(std::string{ws[1].tag} == "second");
+	CHECK(ws[1].position == 1);
+	CHECK(ws[1].permits == 0);
+
+	sem.release();
+	ctx.poll();
+	ctx.restart();
+	ws = registry.waiters();
+	REQUIRE(ws.size() == 1);
+	CHECK(std::string{ws[0].tag} == "second");
+	CHECK(ws[0].position == 0);
+
+	std::ostringstream os;
+	registry.dump(os);
+	CHECK(os.str().find("tag=second") != std::string::npos);
+	CHECK(os.str().find("permits=0") != std::string::npos);
+}
+
+TEST_CASE("waiter_registry only parked waits", "[waiter_registry]")
+{
+	auto& registry = coma::waiter_registry::global();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 1};
+	coma::async_semaphore<executor> other{ctx.get_executor(), 0};
+	sem.async_acquire([](boost::system::error_code) {});
+	CHECK(registry.waiters().empty());
+	ctx.poll();
+	ctx.restart();
+	CHECK(registry.waiters().empty());
+
+	sem.async_acquire_n(2, coma::tag_wait("n", [](boost::system::error_code) {}));
+	other.async_acquire([](boost::system::error_code) {});
+	ctx.poll();
+	ctx.restart();
+	// woken without enough permits, parks again
+	sem.release();
+	ctx.poll();
+	ctx.restart();
+	CHECK(sem.stats().spurious_wakeups == 1);
+	auto ws = registry.waiters();
+	REQUIRE(ws.size() == 2);
+	const auto& w = ws[0].primitive == &sem ? ws[0] : ws[1];
+	CHECK(w.primitive == &sem);
+	CHECK(std::string{w.tag} == "n");
+	CHECK(w.position == 0);
+	CHECK(w.permits == 1);
+
+	sem.release();
+	other.release();
+	ctx.poll();
+	CHECK(registry.waiters().empty());
+}
+
+TEST_CASE("waiter_registry destroyed primitive", "[waiter_registry]")
+{
+	auto& registry = coma::waiter_registry::global();
+	boost::asio::io_context ctx;
+	{
+		coma::async_cond_var<executor> cv{ctx.get_executor()};
+		cv.async_wait([](boost::system::error_code) {});
+		ctx.poll();
+		ctx.restart();
+		const auto ws = registry.waiters();
+		REQUIRE(ws.size() == 1);
+		CHECK(ws[0].permits == -1);
+		CHECK(ws[0].tag == nullptr);
+	}
+	CHECK(registry.waiters().empty());
+}
+
+TEST_CASE("stall_watchdog reports", "[waiter_registry]")
+{
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> sem{ctx.get_executor(), 0};
+	sem.async_acquire([](boost::system::error_code) {});
+	std::vector<coma::waiter_info> reported;
+	coma::stall_watchdog<executor> dog{
+		ctx.get_executor(), std::chrono::milliseconds{5}, std::chrono::milliseconds{2},
+		[&](const std::vector<coma::waiter_info>& ws) { reported = ws; }};
+	dog.start();
+	ctx.run_for(std::chrono::milliseconds{50});
+	REQUIRE(reported.size() == 1);
+	CHECK(reported[0].primitive != nullptr);
+	dog.stop();
+	sem.release();
+	ctx.restart();
+	ctx.run();
+	CHECK(coma::waiter_registry::global().waiters().empty());
+}
+
+TEST_CASE("waiter_registry tag of timed wait", "[waiter_registry]")
+{
+	auto& registry = coma::waiter_registry::global();
+	boost::asio::io_context ctx;
+	coma::async_cond_var_timed<executor> cv{ctx.get_executor()};
+	boost::system::error_code result;
+	cv.async_wait_for(std::chrono::hours{1},
+					  coma::tag_wait("timed", [&](boost::system::error_code ec, coma::cv_status) {
+						  result = ec;
+					  }));
+	ctx.poll();
+	ctx.restart();
+	auto ws = registry.waiters();
+	REQUIRE(ws.size() == 1);
+	CHECK(std::string{ws[0].tag} == "timed");
+	cv.notify_one();
+	ctx.run();
+	CHECK(!result);
+	CHECK(registry.waiters().empty());
+}
+
+#if defined(COMA_COROUTINES) && defined(COMA_ENABLE_COROUTINE_TESTS)
+
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+
+TEST_CASE("waiter_registry coro interleaved tags", "[waiter_registry]")
+{
+	auto& registry = coma::waiter_registry::global();
+	boost::asio::io_context ctx;
+	coma::async_semaphore<executor> first{ctx.get_executor(), 0};
+	coma::async_semaphore<executor> second{ctx.get_executor(), 0};
+	int done = 0;
+
+	// a is suspended with a tagged wait while b starts its waits
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await first.async_acquire(coma::tag_wait("a", use_awaitable));
+			co_await second.async_acquire(use_awaitable);
+			++done;
+		},
+		boost::asio::detached);
+	boost::asio::co_spawn(
+		ctx,
+		[&]() -> awaitable<void> {
+			co_await second.async_acquire(use_awaitable);
+			co_await second.async_acquire(coma::tag_wait("b", use_awaitable));
+			++done;
+		},
+		boost::asio::detached);
+	ctx.poll();
+	ctx.restart();
+	auto ws = registry.waiters();
+	REQUIRE(ws.size() == 2);
+	const auto& a = ws[0].primitive == &first ? ws[0] : ws[1];
+	const auto& b = ws[0].primitive == &first ? ws[1] : ws[0];
+	CHECK(std::string{a.tag} == "a");
+	CHECK(b.tag == nullptr);
+
+	// b parks again with its own tag, a resumes and parks untagged behind it
+	second.release();
+	first.release();
+	ctx.poll();
+	ctx.restart();
+	ws = registry.waiters();
+	REQUIRE(ws.size() == 2);
+	CHECK(ws[0].primitive == &second);
+	CHECK(std::string{ws[0].tag} == "b");
+	CHECK(ws[1].tag == nullptr);
+	CHECK(ws[1].position == 1);
+
+	second.release(2);
+	ctx.run();
+	CHECK(done == 2);
+	CHECK(registry.waiters().empty());
+}
+
+#endif